@@ -0,0 +1,138 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Clock.hpp>
+
+#include "core/world.hpp"
+#include "core/fixed_step_clock.hpp"
+
+/*----------------------------------------------------------------.
+| Runs the same crowded scenario once for every storage layout    |
+| and once for every other kernel tier the processor supports,    |
+| and prints the time per step. Random draws are derived from the |
+| tick and the field, and every tier computes exactly what the    |
+| scalar kernels do, so all runs must end with the same           |
+| statistics and the same image.                                  |
+`----------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+	// Parse the command line.
+	std::string terrain_path{ "_texture/world_maps_seapath.png" };
+	unsigned long long total_ticks = 500;
+	unsigned repeat = 1;    // Copies of the terrain side by side and on top of each other.
+	unsigned thread_count = std::thread::hardware_concurrency();
+	CpuTier tier = detect_cpu_tier();
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg{ argv[i] };
+		const bool has_value = (i + 1 < argc);
+		if (arg == "--ticks" && has_value)
+			total_ticks = std::stoull(argv[++i]);
+		else if (arg == "--terrain" && has_value)
+			terrain_path = argv[++i];
+		else if (arg == "--repeat" && has_value)
+			repeat = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+		else if (arg == "--threads" && has_value)
+			thread_count = static_cast<unsigned>(std::stoul(argv[++i]));
+		else if (arg == "--simd" && has_value && parse_cpu_tier(argv[i + 1], tier))
+			++i;
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--terrain <png>] [--ticks <n>] [--repeat <n>] [--threads <n>] [--simd <scalar|sse2|sse4.2|avx2|avx512>]\n";
+			return 1;
+		}
+	}
+
+	// Background map, repeated to get a larger world.
+	sf::Image background_map_image;
+	if (!background_map_image.loadFromFile(terrain_path))
+	{
+		std::cerr << "Could not load terrain from " << terrain_path << "\n";
+		return 1;
+	}
+	const unsigned IMAGE_WIDTH = background_map_image.getSize().x, IMAGE_HEIGHT = background_map_image.getSize().y;
+	const unsigned WIDTH = IMAGE_WIDTH * repeat, HEIGHT = IMAGE_HEIGHT * repeat;
+	std::vector<std::uint8_t> terrain(std::size_t{ WIDTH } * HEIGHT * 4);
+	for (unsigned y = 0; y < HEIGHT; ++y)
+	{
+		const std::uint8_t* row = background_map_image.getPixelsPtr() + std::size_t{ y % IMAGE_HEIGHT } * IMAGE_WIDTH * 4;
+		for (unsigned copy = 0; copy < repeat; ++copy)
+			std::copy_n(row, std::size_t{ IMAGE_WIDTH } * 4, &terrain[(std::size_t{ y } * WIDTH + copy * IMAGE_WIDTH) * 4]);
+	}
+
+	const Config defaults = with_counter_based_random(default_config(), true);
+	const Layout LAYOUTS[] = { Layout::RowMajor, Layout::Tiled, Layout::Morton };
+	const char* LAYOUT_NAMES[] = { "row-major", "tiled", "morton" };
+
+	// Every layout with the chosen kernels, then the first layout with each other tier.
+	struct Run
+	{
+		unsigned layout;
+		CpuTier tier;
+	};
+	std::vector<Run> runs;
+	for (unsigned i = 0; i < 3; ++i)
+		runs.push_back(Run{ i, tier });
+	for (unsigned i = 0; i <= static_cast<unsigned>(detect_cpu_tier()); ++i)
+	{
+		if (static_cast<CpuTier>(i) != tier)
+			runs.push_back(Run{ 0, static_cast<CpuTier>(i) });
+	}
+
+	std::string reference_name, reference_stats;
+	std::vector<std::uint8_t> reference_pixels;
+	for (const Run& run : runs)
+	{
+		const std::string name = std::string{ LAYOUT_NAMES[run.layout] } + ", " + cpu_tier_name(run.tier);
+
+		// Four teams spread over the whole map.
+		World world{ with_layout(defaults, LAYOUTS[run.layout]), WIDTH, HEIGHT, terrain.data(), thread_count, run.tier };
+		const Color COLORS[] = { { 255, 0, 0, 255 }, { 255, 200, 0, 255 }, { 128, 0, 255, 255 }, { 0, 128, 255, 255 } };
+		for (const Color& color : COLORS)
+			world.spawn_tribe(0, 0, WIDTH, HEIGHT, world.add_team("Team " + std::to_string(world.teams().size()), color), WIDTH * HEIGHT / 8);
+		world.set_painting(false);
+
+		sf::Clock run_clock;
+		for (unsigned long long tick = 1; tick <= total_ticks; ++tick)
+			world.step(SIMULATED_YEARS_PER_STEP, tick == total_ticks);
+		const float elapsed = run_clock.getElapsedTime().asSeconds();
+		std::cout << name << ": " << (elapsed * 1000.f / total_ticks) << " ms/step\n";
+
+		// Every run has to reach the same population and, painted from scratch, the same image.
+		world.repaint();
+		const std::string stats = population_statistics_to_string(world.population_stats(), world.teams());
+		if (reference_stats.empty())
+		{
+			reference_name = name;
+			reference_stats = stats;
+			reference_pixels = world.pixels();
+		}
+		else if (stats != reference_stats || world.pixels() != reference_pixels)
+		{
+			std::cerr << "Population or image of " << name << " differs from " << reference_name << ":\n" << stats;
+			return 1;
+		}
+	}
+	std::cout << WIDTH << "x" << HEIGHT << " fields, " << total_ticks << " ticks, " << cpu_tier_name(tier) << " kernels\n" << reference_stats;
+	return 0;
+}
@@ -0,0 +1,64 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Simulated years every fixed step advances the world by.
+const float SIMULATED_YEARS_PER_STEP = 1.f / 60.f;
+
+/*-----------------------------------------------------------------.
+| Turns elapsed real time into a whole number of fixed-size steps. |
+| Time beyond the catch-up cap is dropped, so a slow frame slows   |
+| the simulation down instead of making everyone age in one jump.  |
+`-----------------------------------------------------------------*/
+struct FixedStepClock
+{
+	// Real seconds between two steps.
+	const double StepSeconds;
+
+	// Most steps that are due after a single frame.
+	const unsigned MaxCatchUpSteps;
+
+	// Constructor.
+	FixedStepClock(double steps_per_second, unsigned max_catch_up_steps)
+		: StepSeconds{ 1.0 / steps_per_second },
+			MaxCatchUpSteps{ max_catch_up_steps > 0 ? max_catch_up_steps : 1 }
+	{}
+
+	// Add `elapsed` real seconds and return the number of steps that are due.
+	unsigned advance(double elapsed)
+	{
+		accumulator += elapsed;
+		unsigned long long steps = static_cast<unsigned long long>(accumulator / StepSeconds);
+		if (steps > MaxCatchUpSteps)
+		{
+			dropped_steps += steps - MaxCatchUpSteps;
+			steps = MaxCatchUpSteps;
+			accumulator = 0.0;
+		}
+		else
+			accumulator -= steps * StepSeconds;
+		return static_cast<unsigned>(steps);
+	}
+
+	// Number of steps skipped to honor the catch-up cap.
+	unsigned long long dropped() const { return dropped_steps; }
+
+private:
+	double accumulator = 0.0;
+	unsigned long long dropped_steps = 0;
+};
@@ -0,0 +1,163 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "kernels.hpp"
+#include "world.hpp"
+
+#include <algorithm>
+
+#if defined(PIXELCIV_X86_64) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static const char* TIER_NAMES[] = { "scalar", "sse2", "sse4.2", "avx2", "avx512" };
+
+CpuTier detect_cpu_tier()
+{
+#if defined(PIXELCIV_X86_64) && defined(_MSC_VER)
+	int registers[4];
+	__cpuid(registers, 1);
+	const bool sse2 = true;    // Part of x86-64.
+	const bool sse42 = (registers[2] & (1 << 20)) != 0;
+	const bool os_saves_ymm = (registers[2] & (1 << 27)) && (_xgetbv(0) & 0x06) == 0x06;
+	const bool os_saves_zmm = os_saves_ymm && (_xgetbv(0) & 0xe6) == 0xe6;
+	__cpuidex(registers, 7, 0);
+	const bool avx2 = os_saves_ymm && (registers[1] & (1 << 5));
+	const bool avx512 = os_saves_zmm && (registers[1] & (1 << 16)) && (registers[1] & (1 << 30));
+#elif defined(PIXELCIV_X86_64)
+	// Also checks that the operating system saves the vector registers.
+	__builtin_cpu_init();
+	const bool sse2 = true;    // Part of x86-64.
+	const bool sse42 = __builtin_cpu_supports("sse4.2");
+	const bool avx2 = __builtin_cpu_supports("avx2");
+	const bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#else
+	const bool sse2 = false, sse42 = false, avx2 = false, avx512 = false;
+#endif
+	return (avx512 ? CpuTier::AVX512 : (avx2 ? CpuTier::AVX2 : (sse42 ? CpuTier::SSE42 : (sse2 ? CpuTier::SSE2 : CpuTier::Scalar))));
+}
+
+const char* cpu_tier_name(CpuTier tier)
+{
+	return TIER_NAMES[static_cast<unsigned>(tier)];
+}
+
+bool parse_cpu_tier(const std::string& name, CpuTier& tier)
+{
+	for (unsigned i = 0; i < sizeof(TIER_NAMES) / sizeof(TIER_NAMES[0]); ++i)
+	{
+		if (name == TIER_NAMES[i])
+		{
+			tier = static_cast<CpuTier>(i);
+			return (tier <= detect_cpu_tier());
+		}
+	}
+	return false;
+}
+
+Kernels kernels_for(CpuTier tier)
+{
+#ifdef PIXELCIV_X86_64
+	if (tier == CpuTier::AVX512)
+		return avx512_kernels();
+	if (tier == CpuTier::AVX2)
+		return avx2_kernels();
+	if (tier == CpuTier::SSE42)
+		return sse42_kernels();
+	if (tier == CpuTier::SSE2)
+		return sse2_kernels();
+#endif
+	return Kernels{ CpuTier::Scalar, scan_occupancy_scalar, age_block_scalar, count_stats_scalar, convert_palette_scalar, compose_scalar };
+}
+
+unsigned scan_occupancy_scalar(std::uint64_t bits, unsigned base, unsigned* slots)
+{
+	unsigned count = 0;
+	for (; bits != 0; bits &= bits - 1)
+		slots[count++] = base + lowest_set_bit(bits);
+	return count;
+}
+
+AgingEvents age_block_scalar(const AgingSlots& slots, unsigned block, std::uint64_t occupied, const AgingStep& step)
+{
+	AgingEvents events{ 0, 0, 0 };
+	for (; occupied != 0; occupied &= occupied - 1)
+	{
+		const unsigned lane = lowest_set_bit(occupied);
+		const unsigned slot = block * 64 + lane;
+		const std::uint64_t bit = std::uint64_t{ 1 } << lane;
+
+		// Increase age and check if the person is dead.
+		std::uint32_t age = slots.age[slot] + step.delta;
+		if (age >= whole_years(std::min<unsigned>(slots.strength[slot], MAX_AGE)))
+		{
+			events.died |= bit;
+			continue;
+		}
+
+		// Decrease reproduction counter.
+		if (!(slots.is_male[slot]))
+			slots.reproduction[slot] = count_down(slots.reproduction[slot], step.delta);
+
+		// Sick persons age faster until the disease is over, healthy ones wait for the next one.
+		if (slots.disease[slot] > 0)
+		{
+			age += step.diseased_extra;
+			slots.disease[slot] = count_down(slots.disease[slot], step.delta);
+			if (slots.disease[slot] == 0)
+				events.recovered |= bit;
+		}
+		else
+		{
+			slots.until_disease[slot] = count_down(slots.until_disease[slot], step.delta);
+			if (slots.until_disease[slot] == 0)
+				events.fell_ill |= bit;
+		}
+		slots.age[slot] = saturate_years(age);
+	}
+	return events;
+}
+
+void count_stats_scalar(const StatsSlots& slots, unsigned block, std::uint64_t occupied, PopulationStats* stats)
+{
+	for (; occupied != 0; occupied &= occupied - 1)
+	{
+		const unsigned slot = block * 64 + lowest_set_bit(occupied);
+		PopulationStats& team_stats = stats[slots.team[slot]];
+		team_stats.count_total++;
+		team_stats.sum_strength += slots.strength[slot];
+		team_stats.sum_age += slots.age[slot] / FIXED_YEARS_PER_YEAR;
+		if (slots.disease[slot] > 0) team_stats.count_diseased++;
+	}
+}
+
+void convert_palette_scalar(const std::uint8_t* teams, const std::uint8_t* sick, unsigned count, const std::uint8_t* palette, std::uint8_t* rgba)
+{
+	for (unsigned i = 0; i < count; ++i)
+	{
+		std::copy_n(&palette[teams[i] * 4], 4, &rgba[std::size_t{ i } * 4]);
+		if (sick[i])
+			rgba[std::size_t{ i } * 4 + 3] = 160;
+	}
+}
+
+void compose_scalar(const std::uint8_t* persons, const std::uint8_t* teams, const std::uint8_t* background, unsigned count, std::uint8_t* rgba)
+{
+	for (unsigned i = 0; i < count; ++i)
+		std::copy_n(&(teams[i] != NO_TEAM ? persons : background)[std::size_t{ i } * 4], 4, &rgba[std::size_t{ i } * 4]);
+}
@@ -0,0 +1,161 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct PopulationStats;
+
+/*------------------------------------------------------------------.
+| Instruction set extensions the kernels are written for, from the  |
+| scalar reference up. Each tier includes the ones below it.        |
+`------------------------------------------------------------------*/
+enum class CpuTier : std::uint8_t
+{
+	Scalar,
+	SSE2,     // Only aging, the other kernels are the scalar ones.
+	SSE42,
+	AVX2,
+	AVX512    // AVX-512 F and BW.
+};
+
+// The widest tier the processor and the operating system support.
+CpuTier detect_cpu_tier();
+
+// Name of `tier` as accepted by `parse_cpu_tier()`: scalar, sse2, sse4.2, avx2 or avx512.
+const char* cpu_tier_name(CpuTier tier);
+
+// Set `tier` to the tier called `name`. Returns false if there is none or the processor lacks it.
+bool parse_cpu_tier(const std::string& name, CpuTier& tier);
+
+/*----------------------------------------------------------.
+| The attribute arrays of the population, indexed by slot.  |
+| Time counters are FixedYears, 1/256 years.                |
+`----------------------------------------------------------*/
+struct AgingSlots
+{
+	std::uint16_t* age;
+	std::uint16_t* disease;
+	std::uint16_t* until_disease;
+	std::uint16_t* reproduction;
+	const std::uint8_t* is_male;
+	const std::uint8_t* strength;
+};
+
+// The attributes the statistics are counted from.
+struct StatsSlots
+{
+	const std::uint8_t* team;
+	const std::uint8_t* strength;
+	const std::uint16_t* age;
+	const std::uint16_t* disease;
+};
+
+/*-----------------------------------------------------.
+| How far a step advances the counters, in FixedYears. |
+`-----------------------------------------------------*/
+struct AgingStep
+{
+	std::uint16_t delta;
+	std::uint16_t diseased_extra;    // Added to the age of sick persons on top of `delta`.
+};
+
+/*-----------------------------------------------------------.
+| Persons of a block of 64 slots, one bit each, that need    |
+| more than arithmetic after aging.                          |
+`-----------------------------------------------------------*/
+struct AgingEvents
+{
+	std::uint64_t died;         // Reached the end of their life. Their counters are left as they were.
+	std::uint64_t recovered;    // Their disease ended.
+	std::uint64_t fell_ill;     // Their healthy time ran out, the caller draws their disease.
+};
+
+/*-------------------------------------------------------------------.
+| Write `base` plus the position of every bit set in `bits` to       |
+| `slots`, in ascending order, and return their number. `slots`      |
+| needs room for 64 entries, the ones past the returned number may   |
+| be overwritten.                                                    |
+`-------------------------------------------------------------------*/
+typedef unsigned (*OccupancyScanKernel)(std::uint64_t bits, unsigned base, unsigned* slots);
+
+/*-------------------------------------------------------------------.
+| Age the persons in the slots [64 * block, 64 * block + 64) whose   |
+| bit is set in `occupied` by one step: count down their disease,    |
+| healthy time and, for women, reproduction time, and find the ones  |
+| that die, recover or fall ill. All persons are handled with the    |
+| same instructions, masks take the place of branches.               |
+`-------------------------------------------------------------------*/
+typedef AgingEvents (*AgingKernel)(const AgingSlots& slots, unsigned block, std::uint64_t occupied, const AgingStep& step);
+
+/*-------------------------------------------------------------------.
+| Add the persons in the slots [64 * block, 64 * block + 64) whose   |
+| bit is set in `occupied` to the statistics of their teams, which   |
+| `stats` holds indexed by team.                                     |
+`-------------------------------------------------------------------*/
+typedef void (*StatsKernel)(const StatsSlots& slots, unsigned block, std::uint64_t occupied, PopulationStats* stats);
+
+/*-------------------------------------------------------------------.
+| Convert `count` fields to RGBA pixels: the color of their team in  |
+| the 256 RGBA entries of `palette`, with an alpha of 160 where      |
+| `sick` is set.                                                     |
+`-------------------------------------------------------------------*/
+typedef void (*PaletteKernel)(const std::uint8_t* teams, const std::uint8_t* sick, unsigned count, const std::uint8_t* palette, std::uint8_t* rgba);
+
+/*-------------------------------------------------------------------.
+| Compose `count` RGBA pixels of the map image: the pixel of the     |
+| person where `teams` is not NO_TEAM, otherwise the background.     |
+`-------------------------------------------------------------------*/
+typedef void (*ComposeKernel)(const std::uint8_t* persons, const std::uint8_t* teams, const std::uint8_t* background, unsigned count, std::uint8_t* rgba);
+
+/*-------------------------------------------------------------------.
+| The hot kernels of the simulation, all of the same tier. Kernels   |
+| that work on blocks of 64 slots load and store the whole block     |
+| above the scalar tier, so they may only be called for blocks no    |
+| other thread writes to. The scalar kernels only touch the slots    |
+| in `occupied`, and every tier gives exactly their results.         |
+`-------------------------------------------------------------------*/
+struct Kernels
+{
+	CpuTier tier;
+	OccupancyScanKernel scan_occupancy;
+	AgingKernel age_block;
+	StatsKernel count_stats;
+	PaletteKernel convert_palette;
+	ComposeKernel compose;
+};
+
+// The kernels of `tier`, which the processor has to support.
+Kernels kernels_for(CpuTier tier);
+
+// Scalar reference kernels.
+unsigned scan_occupancy_scalar(std::uint64_t bits, unsigned base, unsigned* slots);
+AgingEvents age_block_scalar(const AgingSlots& slots, unsigned block, std::uint64_t occupied, const AgingStep& step);
+void count_stats_scalar(const StatsSlots& slots, unsigned block, std::uint64_t occupied, PopulationStats* stats);
+void convert_palette_scalar(const std::uint8_t* teams, const std::uint8_t* sick, unsigned count, const std::uint8_t* palette, std::uint8_t* rgba);
+void compose_scalar(const std::uint8_t* persons, const std::uint8_t* teams, const std::uint8_t* background, unsigned count, std::uint8_t* rgba);
+
+// Vector kernels, in kernels_x86.cpp.
+#if defined(__x86_64__) || defined(_M_X64)
+#define PIXELCIV_X86_64
+Kernels sse2_kernels();
+Kernels sse42_kernels();
+Kernels avx2_kernels();
+Kernels avx512_kernels();
+#endif
@@ -0,0 +1,586 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "kernels.hpp"
+#include "world.hpp"
+
+#ifdef PIXELCIV_X86_64
+
+#include <cstring>
+#include <immintrin.h>
+
+// Every function is compiled for the instructions of its tier only, so the library needs no
+// architecture flags and still runs on processors of a lower tier.
+#ifdef _MSC_VER
+#define TARGET_SSE42
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,popcnt")))
+#endif
+
+// Alpha of the pixel of a sick person, in the highest byte of an RGBA pixel.
+static const int SICK_ALPHA = static_cast<int>(160u << 24);
+
+/*---------------------------------------------------------------.
+| Positions of the set bits of every byte value, lowest first.   |
+`---------------------------------------------------------------*/
+struct BitPositions
+{
+	std::uint8_t of[256][8];
+};
+
+static constexpr BitPositions make_bit_positions()
+{
+	BitPositions positions{};
+	for (unsigned value = 0; value < 256; ++value)
+	{
+		unsigned count = 0;
+		for (unsigned bit = 0; bit < 8; ++bit)
+		{
+			if ((value >> bit) & 1)
+				positions.of[value][count++] = static_cast<std::uint8_t>(bit);
+		}
+	}
+	return positions;
+}
+
+static constexpr BitPositions BIT_POSITIONS = make_bit_positions();
+
+// Four bytes from `bytes` as one lane.
+static int load_lane(const std::uint8_t* bytes)
+{
+	int lane;
+	std::memcpy(&lane, bytes, 4);
+	return lane;
+}
+
+// Whether the bit loop of the scalar scan is faster than decoding every byte of `bits`.
+TARGET_SSE42 static bool is_sparse(std::uint64_t bits)
+{
+	return _mm_popcnt_u64(bits) <= 8;
+}
+
+/*------------------------------------------------------.
+| SSE2. Part of every x86-64 processor, so it needs no  |
+| target attribute. Only aging has a kernel of its own, |
+| which the SSE4.2 tier uses as well.                   |
+`------------------------------------------------------*/
+
+// Bits of the 16-bit lanes of `mask` that are all ones.
+static unsigned lane_bits(__m128i mask)
+{
+	return static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(mask, _mm_setzero_si128())));
+}
+
+// `a` in the lanes set in `mask`, `b` in the others.
+static __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static AgingEvents age_block_sse2(const AgingSlots& slots, unsigned block, std::uint64_t occupied, const AgingStep& step)
+{
+	const __m128i ZERO = _mm_setzero_si128();
+	const __m128i LANE_BITS = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m128i MAX_LIFESPAN = _mm_set1_epi16(MAX_AGE);
+	const __m128i DELTA = _mm_set1_epi16(static_cast<short>(step.delta));
+	const __m128i DISEASED_EXTRA = _mm_set1_epi16(static_cast<short>(step.diseased_extra));
+
+	AgingEvents events{ 0, 0, 0 };
+	for (unsigned lane = 0; lane < 64; lane += 8)
+	{
+		const unsigned slot = block * 64 + lane;
+		const __m128i person = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(static_cast<short>((occupied >> lane) & 0xff)), LANE_BITS), LANE_BITS);
+		const __m128i is_male = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(slots.is_male + slot)), ZERO);
+		const __m128i strength = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(slots.strength + slot)), ZERO);
+		const __m128i age = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.age + slot));
+		const __m128i disease = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.disease + slot));
+		const __m128i until_disease = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.until_disease + slot));
+		const __m128i reproduction = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.reproduction + slot));
+
+		// Increase age and check if the person is dead: a saturated `lifespan - age` of 0 means `age >= lifespan`.
+		const __m128i lifespan = _mm_slli_epi16(_mm_min_epi16(strength, MAX_LIFESPAN), 8);
+		const __m128i older = _mm_adds_epu16(age, DELTA);
+		const __m128i died = _mm_and_si128(person, _mm_cmpeq_epi16(_mm_subs_epu16(lifespan, older), ZERO));
+		const __m128i alive = _mm_andnot_si128(died, person);
+
+		// Count down reproduction for women, the disease for the sick and the healthy time for everybody else.
+		const __m128i healthy = _mm_cmpeq_epi16(disease, ZERO);
+		const __m128i new_age = _mm_adds_epu16(older, _mm_andnot_si128(healthy, DISEASED_EXTRA));
+		const __m128i new_reproduction = _mm_subs_epu16(reproduction, _mm_and_si128(_mm_cmpeq_epi16(is_male, ZERO), DELTA));
+		const __m128i new_disease = _mm_subs_epu16(disease, DELTA);
+		const __m128i new_until_disease = _mm_subs_epu16(until_disease, _mm_and_si128(healthy, DELTA));
+		const __m128i recovered = _mm_andnot_si128(healthy, _mm_and_si128(alive, _mm_cmpeq_epi16(new_disease, ZERO)));
+		const __m128i fell_ill = _mm_and_si128(healthy, _mm_and_si128(alive, _mm_cmpeq_epi16(new_until_disease, ZERO)));
+
+		// Only the living persons change.
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(slots.age + slot), select(alive, new_age, age));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(slots.disease + slot), select(alive, new_disease, disease));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(slots.until_disease + slot), select(alive, new_until_disease, until_disease));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(slots.reproduction + slot), select(alive, new_reproduction, reproduction));
+
+		events.died |= std::uint64_t{ lane_bits(died) } << lane;
+		events.recovered |= std::uint64_t{ lane_bits(recovered) } << lane;
+		events.fell_ill |= std::uint64_t{ lane_bits(fell_ill) } << lane;
+	}
+	return events;
+}
+
+Kernels sse2_kernels()
+{
+	return Kernels{ CpuTier::SSE2, scan_occupancy_scalar, age_block_sse2, count_stats_scalar, convert_palette_scalar, compose_scalar };
+}
+
+/*--------.
+| SSE4.2. |
+`--------*/
+
+// Bytes that are all ones for the bits set in the lowest 16 of `bits`.
+TARGET_SSE42 static __m128i byte_mask_16(unsigned bits)
+{
+	const __m128i SPREAD = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+	const __m128i BITS = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	return _mm_cmpeq_epi8(_mm_and_si128(_mm_shuffle_epi8(_mm_cvtsi32_si128(static_cast<int>(bits)), SPREAD), BITS), BITS);
+}
+
+// Sum of the bytes of `values`.
+TARGET_SSE42 static int byte_sum(__m128i values)
+{
+	const __m128i sums = _mm_sad_epu8(values, _mm_setzero_si128());
+	return _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+}
+
+TARGET_SSE42 static unsigned scan_occupancy_sse42(std::uint64_t bits, unsigned base, unsigned* slots)
+{
+	if (is_sparse(bits))
+		return scan_occupancy_scalar(bits, base, slots);
+
+	unsigned count = 0;
+	for (unsigned byte = 0; byte < 8; ++byte)
+	{
+		const unsigned value = (bits >> (byte * 8)) & 0xff;
+		const __m128i offset = _mm_set1_epi32(static_cast<int>(base + byte * 8));
+		const __m128i positions = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(BIT_POSITIONS.of[value]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(slots + count), _mm_add_epi32(_mm_cvtepu8_epi32(positions), offset));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(slots + count + 4), _mm_add_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(positions, 4)), offset));
+		count += static_cast<unsigned>(_mm_popcnt_u32(value));
+	}
+	return count;
+}
+
+TARGET_SSE42 static void count_stats_sse42(const StatsSlots& slots, unsigned block, std::uint64_t occupied, PopulationStats* stats)
+{
+	// Team, strength and whole years of age of the block as bytes, in four parts of 16 slots.
+	const __m128i ZERO = _mm_setzero_si128();
+	__m128i persons[4], teams[4], strengths[4], years[4];
+	std::uint64_t sick = 0;
+	for (unsigned part = 0; part < 4; ++part)
+	{
+		const unsigned slot = block * 64 + part * 16;
+		persons[part] = byte_mask_16(static_cast<unsigned>(occupied >> (part * 16)));
+		teams[part] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.team + slot));
+		strengths[part] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.strength + slot));
+		const __m128i age_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.age + slot));
+		const __m128i age_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.age + slot + 8));
+		years[part] = _mm_packus_epi16(_mm_srli_epi16(age_low, 8), _mm_srli_epi16(age_high, 8));
+		const __m128i disease_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.disease + slot));
+		const __m128i disease_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.disease + slot + 8));
+		const __m128i healthy = _mm_packs_epi16(_mm_cmpeq_epi16(disease_low, ZERO), _mm_cmpeq_epi16(disease_high, ZERO));
+		sick |= std::uint64_t{ ~static_cast<unsigned>(_mm_movemask_epi8(healthy)) & 0xffff } << (part * 16);
+	}
+
+	// Add up one team after the other, a block rarely holds more than two.
+	for (std::uint64_t remaining = occupied; remaining != 0;)
+	{
+		const std::uint8_t team = slots.team[block * 64 + lowest_set_bit(remaining)];
+		const __m128i TEAM = _mm_set1_epi8(static_cast<char>(team));
+		std::uint64_t members = 0;
+		int sum_strength = 0, sum_age = 0;
+		for (unsigned part = 0; part < 4; ++part)
+		{
+			const __m128i member = _mm_and_si128(persons[part], _mm_cmpeq_epi8(teams[part], TEAM));
+			members |= std::uint64_t{ static_cast<unsigned>(_mm_movemask_epi8(member)) } << (part * 16);
+			sum_strength += byte_sum(_mm_and_si128(member, strengths[part]));
+			sum_age += byte_sum(_mm_and_si128(member, years[part]));
+		}
+		PopulationStats& team_stats = stats[team];
+		team_stats.count_total += static_cast<int>(_mm_popcnt_u64(members));
+		team_stats.count_diseased += static_cast<int>(_mm_popcnt_u64(members & sick));
+		team_stats.sum_strength += sum_strength;
+		team_stats.sum_age += sum_age;
+		remaining &= ~members;
+	}
+}
+
+TARGET_SSE42 static void convert_palette_sse42(const std::uint8_t* teams, const std::uint8_t* sick, unsigned count, const std::uint8_t* palette, std::uint8_t* rgba)
+{
+	const __m128i COLOR = _mm_set1_epi32(0x00ffffff);
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i colors = _mm_setr_epi32(load_lane(&palette[teams[i] * 4]), load_lane(&palette[teams[i + 1] * 4]),
+			load_lane(&palette[teams[i + 2] * 4]), load_lane(&palette[teams[i + 3] * 4]));
+		const __m128i is_sick = _mm_cmpgt_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(load_lane(sick + i))), _mm_setzero_si128());
+		const __m128i sick_colors = _mm_or_si128(_mm_and_si128(colors, COLOR), _mm_set1_epi32(SICK_ALPHA));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + std::size_t{ i } * 4), _mm_blendv_epi8(colors, sick_colors, is_sick));
+	}
+	convert_palette_scalar(teams + i, sick + i, count - i, palette, rgba + std::size_t{ i } * 4);
+}
+
+TARGET_SSE42 static void compose_sse42(const std::uint8_t* persons, const std::uint8_t* teams, const std::uint8_t* background, unsigned count, std::uint8_t* rgba)
+{
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i empty = _mm_cmpeq_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(load_lane(teams + i))), _mm_setzero_si128());
+		const __m128i person = _mm_loadu_si128(reinterpret_cast<const __m128i*>(persons + std::size_t{ i } * 4));
+		const __m128i ground = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + std::size_t{ i } * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + std::size_t{ i } * 4), _mm_blendv_epi8(person, ground, empty));
+	}
+	compose_scalar(persons + std::size_t{ i } * 4, teams + i, background + std::size_t{ i } * 4, count - i, rgba + std::size_t{ i } * 4);
+}
+
+Kernels sse42_kernels()
+{
+	return Kernels{ CpuTier::SSE42, scan_occupancy_sse42, age_block_sse2, count_stats_sse42, convert_palette_sse42, compose_sse42 };
+}
+
+/*------.
+| AVX2. |
+`------*/
+
+// Bits of the 16-bit lanes of `mask` that are all ones. Packing works within each 128-bit half.
+TARGET_AVX2 static unsigned lane_bits(__m256i mask)
+{
+	const unsigned bytes = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_packs_epi16(mask, _mm256_setzero_si256())));
+	return (bytes & 0xff) | ((bytes >> 8) & 0xff00);
+}
+
+// Bytes that are all ones for the bits set in `bits`.
+TARGET_AVX2 static __m256i byte_mask_32(unsigned bits)
+{
+	const __m256i SPREAD = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+		2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	const __m256i BITS = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201ull));
+	return _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(bits)), SPREAD), BITS), BITS);
+}
+
+// Sum of the bytes of `values`.
+TARGET_AVX2 static int byte_sum(__m256i values)
+{
+	const __m256i sums = _mm256_sad_epu8(values, _mm256_setzero_si256());
+	const __m128i halves = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+	return _mm_cvtsi128_si32(halves) + _mm_extract_epi16(halves, 4);
+}
+
+TARGET_AVX2 static unsigned scan_occupancy_avx2(std::uint64_t bits, unsigned base, unsigned* slots)
+{
+	if (is_sparse(bits))
+		return scan_occupancy_scalar(bits, base, slots);
+
+	unsigned count = 0;
+	for (unsigned byte = 0; byte < 8; ++byte)
+	{
+		const unsigned value = (bits >> (byte * 8)) & 0xff;
+		const __m256i positions = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(BIT_POSITIONS.of[value])));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(slots + count), _mm256_add_epi32(positions, _mm256_set1_epi32(static_cast<int>(base + byte * 8))));
+		count += static_cast<unsigned>(_mm_popcnt_u32(value));
+	}
+	return count;
+}
+
+TARGET_AVX2 static AgingEvents age_block_avx2(const AgingSlots& slots, unsigned block, std::uint64_t occupied, const AgingStep& step)
+{
+	const __m256i ZERO = _mm256_setzero_si256();
+	const __m256i LANE_BITS = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, -32768);
+	const __m256i MAX_LIFESPAN = _mm256_set1_epi16(MAX_AGE);
+	const __m256i DELTA = _mm256_set1_epi16(static_cast<short>(step.delta));
+	const __m256i DISEASED_EXTRA = _mm256_set1_epi16(static_cast<short>(step.diseased_extra));
+
+	AgingEvents events{ 0, 0, 0 };
+	for (unsigned lane = 0; lane < 64; lane += 16)
+	{
+		const unsigned slot = block * 64 + lane;
+		const __m256i person = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16(static_cast<short>((occupied >> lane) & 0xffff)), LANE_BITS), LANE_BITS);
+		const __m256i is_male = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.is_male + slot)));
+		const __m256i strength = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(slots.strength + slot)));
+		const __m256i age = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.age + slot));
+		const __m256i disease = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.disease + slot));
+		const __m256i until_disease = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.until_disease + slot));
+		const __m256i reproduction = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.reproduction + slot));
+
+		// Increase age and check if the person is dead.
+		const __m256i lifespan = _mm256_slli_epi16(_mm256_min_epu16(strength, MAX_LIFESPAN), 8);
+		const __m256i older = _mm256_adds_epu16(age, DELTA);
+		const __m256i died = _mm256_and_si256(person, _mm256_cmpeq_epi16(_mm256_max_epu16(older, lifespan), older));
+		const __m256i alive = _mm256_andnot_si256(died, person);
+
+		// Count down reproduction for women, the disease for the sick and the healthy time for everybody else.
+		const __m256i healthy = _mm256_cmpeq_epi16(disease, ZERO);
+		const __m256i new_age = _mm256_adds_epu16(older, _mm256_andnot_si256(healthy, DISEASED_EXTRA));
+		const __m256i new_reproduction = _mm256_subs_epu16(reproduction, _mm256_and_si256(_mm256_cmpeq_epi16(is_male, ZERO), DELTA));
+		const __m256i new_disease = _mm256_subs_epu16(disease, DELTA);
+		const __m256i new_until_disease = _mm256_subs_epu16(until_disease, _mm256_and_si256(healthy, DELTA));
+		const __m256i recovered = _mm256_andnot_si256(healthy, _mm256_and_si256(alive, _mm256_cmpeq_epi16(new_disease, ZERO)));
+		const __m256i fell_ill = _mm256_and_si256(healthy, _mm256_and_si256(alive, _mm256_cmpeq_epi16(new_until_disease, ZERO)));
+
+		// Only the living persons change.
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(slots.age + slot), _mm256_blendv_epi8(age, new_age, alive));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(slots.disease + slot), _mm256_blendv_epi8(disease, new_disease, alive));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(slots.until_disease + slot), _mm256_blendv_epi8(until_disease, new_until_disease, alive));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(slots.reproduction + slot), _mm256_blendv_epi8(reproduction, new_reproduction, alive));
+
+		events.died |= std::uint64_t{ lane_bits(died) } << lane;
+		events.recovered |= std::uint64_t{ lane_bits(recovered) } << lane;
+		events.fell_ill |= std::uint64_t{ lane_bits(fell_ill) } << lane;
+	}
+	return events;
+}
+
+TARGET_AVX2 static void count_stats_avx2(const StatsSlots& slots, unsigned block, std::uint64_t occupied, PopulationStats* stats)
+{
+	// Team, strength and whole years of age of the block as bytes, in two parts of 32 slots.
+	// Packing works within each 128-bit half, the permutation restores the order of the slots.
+	const __m256i ZERO = _mm256_setzero_si256();
+	__m256i persons[2], teams[2], strengths[2], years[2];
+	std::uint64_t sick = 0;
+	for (unsigned part = 0; part < 2; ++part)
+	{
+		const unsigned slot = block * 64 + part * 32;
+		persons[part] = byte_mask_32(static_cast<unsigned>(occupied >> (part * 32)));
+		teams[part] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.team + slot));
+		strengths[part] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.strength + slot));
+		const __m256i age_low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.age + slot));
+		const __m256i age_high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.age + slot + 16));
+		years[part] = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(age_low, 8), _mm256_srli_epi16(age_high, 8)), 0xd8);
+		const __m256i disease_low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.disease + slot));
+		const __m256i disease_high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.disease + slot + 16));
+		const __m256i healthy = _mm256_permute4x64_epi64(_mm256_packs_epi16(_mm256_cmpeq_epi16(disease_low, ZERO), _mm256_cmpeq_epi16(disease_high, ZERO)), 0xd8);
+		sick |= std::uint64_t{ ~static_cast<unsigned>(_mm256_movemask_epi8(healthy)) } << (part * 32);
+	}
+
+	// Add up one team after the other, a block rarely holds more than two.
+	for (std::uint64_t remaining = occupied; remaining != 0;)
+	{
+		const std::uint8_t team = slots.team[block * 64 + lowest_set_bit(remaining)];
+		const __m256i TEAM = _mm256_set1_epi8(static_cast<char>(team));
+		std::uint64_t members = 0;
+		int sum_strength = 0, sum_age = 0;
+		for (unsigned part = 0; part < 2; ++part)
+		{
+			const __m256i member = _mm256_and_si256(persons[part], _mm256_cmpeq_epi8(teams[part], TEAM));
+			members |= std::uint64_t{ static_cast<unsigned>(_mm256_movemask_epi8(member)) } << (part * 32);
+			sum_strength += byte_sum(_mm256_and_si256(member, strengths[part]));
+			sum_age += byte_sum(_mm256_and_si256(member, years[part]));
+		}
+		PopulationStats& team_stats = stats[team];
+		team_stats.count_total += static_cast<int>(_mm_popcnt_u64(members));
+		team_stats.count_diseased += static_cast<int>(_mm_popcnt_u64(members & sick));
+		team_stats.sum_strength += sum_strength;
+		team_stats.sum_age += sum_age;
+		remaining &= ~members;
+	}
+}
+
+TARGET_AVX2 static void convert_palette_avx2(const std::uint8_t* teams, const std::uint8_t* sick, unsigned count, const std::uint8_t* palette, std::uint8_t* rgba)
+{
+	const __m256i COLOR = _mm256_set1_epi32(0x00ffffff);
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(teams + i)));
+		const __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), indices, 4);
+		const __m256i is_sick = _mm256_cmpgt_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sick + i))), _mm256_setzero_si256());
+		const __m256i sick_colors = _mm256_or_si256(_mm256_and_si256(colors, COLOR), _mm256_set1_epi32(SICK_ALPHA));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + std::size_t{ i } * 4), _mm256_blendv_epi8(colors, sick_colors, is_sick));
+	}
+	convert_palette_scalar(teams + i, sick + i, count - i, palette, rgba + std::size_t{ i } * 4);
+}
+
+TARGET_AVX2 static void compose_avx2(const std::uint8_t* persons, const std::uint8_t* teams, const std::uint8_t* background, unsigned count, std::uint8_t* rgba)
+{
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256i empty = _mm256_cmpeq_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(teams + i))), _mm256_setzero_si256());
+		const __m256i person = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(persons + std::size_t{ i } * 4));
+		const __m256i ground = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(background + std::size_t{ i } * 4));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + std::size_t{ i } * 4), _mm256_blendv_epi8(person, ground, empty));
+	}
+	compose_scalar(persons + std::size_t{ i } * 4, teams + i, background + std::size_t{ i } * 4, count - i, rgba + std::size_t{ i } * 4);
+}
+
+Kernels avx2_kernels()
+{
+	return Kernels{ CpuTier::AVX2, scan_occupancy_avx2, age_block_avx2, count_stats_avx2, convert_palette_avx2, compose_avx2 };
+}
+
+/*---------.
+| AVX-512. |
+`---------*/
+
+TARGET_AVX512 static unsigned scan_occupancy_avx512(std::uint64_t bits, unsigned base, unsigned* slots)
+{
+	if (is_sparse(bits))
+		return scan_occupancy_scalar(bits, base, slots);
+
+	const __m512i LANES = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	unsigned count = 0;
+	for (unsigned part = 0; part < 64; part += 16)
+	{
+		const __mmask16 mask = static_cast<__mmask16>(bits >> part);
+
+		// Compressing into a register and storing all lanes is faster than a compressing store.
+		const __m512i positions = _mm512_add_epi32(LANES, _mm512_set1_epi32(static_cast<int>(base + part)));
+		_mm512_storeu_si512(slots + count, _mm512_maskz_compress_epi32(mask, positions));
+		count += static_cast<unsigned>(_mm_popcnt_u32(mask));
+	}
+	return count;
+}
+
+TARGET_AVX512 static AgingEvents age_block_avx512(const AgingSlots& slots, unsigned block, std::uint64_t occupied, const AgingStep& step)
+{
+	const __m512i MAX_LIFESPAN = _mm512_set1_epi16(MAX_AGE);
+	const __m512i DELTA = _mm512_set1_epi16(static_cast<short>(step.delta));
+	const __m512i DISEASED_EXTRA = _mm512_set1_epi16(static_cast<short>(step.diseased_extra));
+
+	AgingEvents events{ 0, 0, 0 };
+	for (unsigned lane = 0; lane < 64; lane += 32)
+	{
+		const unsigned slot = block * 64 + lane;
+		const __mmask32 person = static_cast<__mmask32>(occupied >> lane);
+		const __m512i is_male = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.is_male + slot)));
+		const __m512i strength = _mm512_cvtepu8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots.strength + slot)));
+		const __m512i age = _mm512_loadu_si512(slots.age + slot);
+		const __m512i disease = _mm512_loadu_si512(slots.disease + slot);
+		const __m512i until_disease = _mm512_loadu_si512(slots.until_disease + slot);
+		const __m512i reproduction = _mm512_loadu_si512(slots.reproduction + slot);
+
+		// Increase age and check if the person is dead.
+		const __m512i lifespan = _mm512_slli_epi16(_mm512_min_epu16(strength, MAX_LIFESPAN), 8);
+		const __m512i older = _mm512_adds_epu16(age, DELTA);
+		const __mmask32 died = _mm512_mask_cmpge_epu16_mask(person, older, lifespan);
+		const __mmask32 alive = person & ~died;
+
+		// Count down reproduction for women, the disease for the sick and the healthy time for everybody else.
+		const __mmask32 healthy = _mm512_testn_epi16_mask(disease, disease);
+		const __m512i new_age = _mm512_mask_adds_epu16(older, ~healthy, older, DISEASED_EXTRA);
+		const __m512i new_reproduction = _mm512_mask_subs_epu16(reproduction, _mm512_testn_epi16_mask(is_male, is_male), reproduction, DELTA);
+		const __m512i new_disease = _mm512_subs_epu16(disease, DELTA);
+		const __m512i new_until_disease = _mm512_mask_subs_epu16(until_disease, healthy, until_disease, DELTA);
+		const __mmask32 recovered = alive & ~healthy & _mm512_testn_epi16_mask(new_disease, new_disease);
+		const __mmask32 fell_ill = alive & healthy & _mm512_testn_epi16_mask(new_until_disease, new_until_disease);
+
+		// Only the living persons change.
+		_mm512_mask_storeu_epi16(slots.age + slot, alive, new_age);
+		_mm512_mask_storeu_epi16(slots.disease + slot, alive, new_disease);
+		_mm512_mask_storeu_epi16(slots.until_disease + slot, alive, new_until_disease);
+		_mm512_mask_storeu_epi16(slots.reproduction + slot, alive, new_reproduction);
+
+		events.died |= std::uint64_t{ died } << lane;
+		events.recovered |= std::uint64_t{ recovered } << lane;
+		events.fell_ill |= std::uint64_t{ fell_ill } << lane;
+	}
+	return events;
+}
+
+// In GCC 12 the casts and the reduction below start from undefined registers, and GCC warns about its
+// own headers. The warnings are turned off for these two functions only.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Sum of the bytes of `values`.
+TARGET_AVX512 static int byte_sum(__m512i values)
+{
+	return static_cast<int>(_mm512_reduce_add_epi64(_mm512_sad_epu8(values, _mm512_setzero_si512())));
+}
+
+TARGET_AVX512 static void count_stats_avx512(const StatsSlots& slots, unsigned block, std::uint64_t occupied, PopulationStats* stats)
+{
+	// Team, strength and whole years of age of the block as bytes.
+	const unsigned first = block * 64;
+	const __m512i teams = _mm512_loadu_si512(slots.team + first);
+	const __m512i strengths = _mm512_loadu_si512(slots.strength + first);
+	const __m512i age_low = _mm512_loadu_si512(slots.age + first);
+	const __m512i age_high = _mm512_loadu_si512(slots.age + first + 32);
+	const __m512i years = _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi16_epi8(_mm512_srli_epi16(age_low, 8))),
+		_mm512_cvtepi16_epi8(_mm512_srli_epi16(age_high, 8)), 1);
+	const __m512i disease_low = _mm512_loadu_si512(slots.disease + first);
+	const __m512i disease_high = _mm512_loadu_si512(slots.disease + first + 32);
+	const std::uint64_t sick = _mm512_test_epi16_mask(disease_low, disease_low) | (std::uint64_t{ _mm512_test_epi16_mask(disease_high, disease_high) } << 32);
+
+	// Add up one team after the other, a block rarely holds more than two.
+	for (std::uint64_t remaining = occupied; remaining != 0;)
+	{
+		const std::uint8_t team = slots.team[first + lowest_set_bit(remaining)];
+		const __mmask64 members = _mm512_mask_cmpeq_epi8_mask(remaining, teams, _mm512_set1_epi8(static_cast<char>(team)));
+		PopulationStats& team_stats = stats[team];
+		team_stats.count_total += static_cast<int>(_mm_popcnt_u64(members));
+		team_stats.count_diseased += static_cast<int>(_mm_popcnt_u64(members & sick));
+		team_stats.sum_strength += byte_sum(_mm512_maskz_mov_epi8(members, strengths));
+		team_stats.sum_age += byte_sum(_mm512_maskz_mov_epi8(members, years));
+		remaining &= ~members;
+	}
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// The conversions and the gather use their zero-masking forms, which start from a zeroed register
+// instead of an undefined one.
+TARGET_AVX512 static void convert_palette_avx512(const std::uint8_t* teams, const std::uint8_t* sick, unsigned count, const std::uint8_t* palette, std::uint8_t* rgba)
+{
+	const __m512i COLOR = _mm512_set1_epi32(0x00ffffff);
+	const __m512i ALPHA = _mm512_set1_epi32(SICK_ALPHA);
+	unsigned i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m512i indices = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(teams + i)));
+		const __m512i colors = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xffff, indices, palette, 4);
+		const __m512i sick_flags = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(sick + i)));
+		const __mmask16 is_sick = _mm512_test_epi32_mask(sick_flags, sick_flags);
+		_mm512_storeu_si512(rgba + std::size_t{ i } * 4, _mm512_mask_or_epi32(colors, is_sick, _mm512_and_si512(colors, COLOR), ALPHA));
+	}
+	convert_palette_scalar(teams + i, sick + i, count - i, palette, rgba + std::size_t{ i } * 4);
+}
+
+TARGET_AVX512 static void compose_avx512(const std::uint8_t* persons, const std::uint8_t* teams, const std::uint8_t* background, unsigned count, std::uint8_t* rgba)
+{
+	unsigned i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m512i team = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(teams + i)));
+		const __m512i person = _mm512_loadu_si512(persons + std::size_t{ i } * 4);
+		const __m512i ground = _mm512_loadu_si512(background + std::size_t{ i } * 4);
+		_mm512_storeu_si512(rgba + std::size_t{ i } * 4, _mm512_mask_blend_epi32(_mm512_testn_epi32_mask(team, team), person, ground));
+	}
+	compose_scalar(persons + std::size_t{ i } * 4, teams + i, background + std::size_t{ i } * 4, count - i, rgba + std::size_t{ i } * 4);
+}
+
+Kernels avx512_kernels()
+{
+	return Kernels{ CpuTier::AVX512, scan_occupancy_avx512, age_block_avx512, count_stats_avx512, convert_palette_avx512, compose_avx512 };
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <random>
+#include <algorithm>
+
+/*----------------------------------------------.
+| The passes a population update is split into. |
+`----------------------------------------------*/
+enum class UpdatePass : std::uint8_t
+{
+	Age,
+	Plan,
+	Arrive,
+	Resolve
+};
+
+/*----------------------------------------------------------.
+| Small-state random number engine (PCG32, XSH-RR variant). |
+`----------------------------------------------------------*/
+struct Pcg32
+{
+	using result_type = std::uint32_t;
+
+	// Constructor. Engines with a different `stream` produce independent sequences.
+	explicit Pcg32(std::uint64_t seed = 0x853c49e6748fea9bULL, std::uint64_t stream = 0xda3e39cb94b95bdbULL)
+		: state{ 0 }, increment{ (stream << 1u) | 1u }
+	{
+		(*this)();
+		state += seed;
+		(*this)();
+	}
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return 0xffffffff; }
+
+	result_type operator()()
+	{
+		const std::uint64_t old_state = state;
+		state = old_state * 6364136223846793005ULL + increment;
+		const std::uint32_t xor_shifted = static_cast<std::uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+		const std::uint32_t rotation = static_cast<std::uint32_t>(old_state >> 59u);
+		return (xor_shifted >> rotation) | (xor_shifted << ((32u - rotation) & 31u));
+	}
+
+private:
+	std::uint64_t state, increment;
+};
+
+// Define `PIXELCIV_RNG_MT19937` to fall back to the standard Mersenne Twister.
+#ifdef PIXELCIV_RNG_MT19937
+using RandomEngine = std::mt19937;
+#else
+using RandomEngine = Pcg32;
+#endif
+
+/*------------------------------------------------------------------.
+| Counter-based generator (Philox4x32-10). Hashes a 128-bit counter |
+| under a 64-bit key into four independent 32-bit draws.            |
+`------------------------------------------------------------------*/
+inline std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+{
+	for (unsigned round = 0; round < 10; ++round)
+	{
+		const std::uint64_t product0 = std::uint64_t{ 0xD2511F53u } * counter[0];
+		const std::uint64_t product1 = std::uint64_t{ 0xCD9E8D57u } * counter[2];
+		counter = { {
+			static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+			static_cast<std::uint32_t>(product1),
+			static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+			static_cast<std::uint32_t>(product0)
+		} };
+		key[0] += 0x9E3779B9u;
+		key[1] += 0xBB67AE85u;
+	}
+	return counter;
+}
+
+/*-------------------------------------------------------------------.
+| Independent random stream owned by a single thread. Raw draws are  |
+| generated in batches and mapped to a range without a distribution. |
+| A counter-based stream instead derives every draw from the seed,   |
+| the simulation tick, the field and the update pass, so results do  |
+| not depend on which worker processes a field.                      |
+`-------------------------------------------------------------------*/
+struct alignas(64) RandomStream
+{
+	// Constructor.
+	RandomStream(unsigned seed, unsigned stream_index, bool counter_based = false)
+#ifdef PIXELCIV_RNG_MT19937
+		: engine{ seed ^ (stream_index * 0x9e3779b9u) },
+#else
+		: engine{ seed, stream_index },
+#endif
+			counter_based{ counter_based },
+			key{ { seed, 0x5eed5eedu } }
+	{}
+
+	// Key the following draws to a tick, a field and an update pass. No effect on sequential streams.
+	void seek(std::uint64_t tick, unsigned cell, UpdatePass pass)
+	{
+		if (!counter_based)
+			return;
+		counter = { { cell, static_cast<std::uint32_t>(pass) << 24, static_cast<std::uint32_t>(tick), static_cast<std::uint32_t>(tick >> 32) } };
+		block_position = block.size();
+	}
+
+	// Generate a random number from `min` to `max`.
+	int range(int min, int max)
+	{
+		// Multiply-shift mapping with rejection of the biased remainder (Lemire).
+		const std::uint32_t span = static_cast<std::uint32_t>(max - min) + 1u;
+		std::uint64_t product = std::uint64_t{ next() } * span;
+		std::uint32_t low = static_cast<std::uint32_t>(product);
+		if (low < span)
+		{
+			const std::uint32_t threshold = (0u - span) % span;
+			while (low < threshold)
+			{
+				product = std::uint64_t{ next() } * span;
+				low = static_cast<std::uint32_t>(product);
+			}
+		}
+		return min + static_cast<int>(product >> 32);
+	}
+
+private:
+	// Take the next raw draw, refilling the whole batch when it is used up.
+	std::uint32_t next()
+	{
+		if (counter_based)
+		{
+			if (block_position == block.size())
+			{
+				block = philox4x32(counter, key);
+				++counter[1];
+				block_position = 0;
+			}
+			return block[block_position++];
+		}
+		if (batch_position == batch.size())
+		{
+			std::generate(batch.begin(), batch.end(), [this] { return static_cast<std::uint32_t>(engine()); });
+			batch_position = 0;
+		}
+		return batch[batch_position++];
+	}
+
+	RandomEngine engine;
+	std::array<std::uint32_t, 64> batch{};
+	std::size_t batch_position = 64;
+
+	// State of counter-based draws.
+	bool counter_based;
+	std::array<std::uint32_t, 2> key;
+	std::array<std::uint32_t, 4> counter{}, block{};
+	std::size_t block_position = 4;
+};
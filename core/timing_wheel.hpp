@@ -0,0 +1,152 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+/*-------------------------------------------------------------------.
+| Hierarchical timing wheel. Entries are kept in buckets by the time |
+| they are due, on three levels of 256 buckets: the lowest level has |
+| a bucket per time unit, every level above one per revolution of    |
+| the level below, whose entries are spilled down once it comes      |
+| round. Scheduling and firing cost O(1) per entry, no matter how    |
+| far ahead it is due. An entry keeps its handle until released, so  |
+| its target can be changed without touching the buckets.            |
+`-------------------------------------------------------------------*/
+struct TimingWheel
+{
+	typedef std::uint32_t Handle;
+	static constexpr Handle NO_HANDLE = 0xffffffffu;
+
+	// Returned by a firing entry to release its handle instead of scheduling it again.
+	static constexpr std::uint32_t RELEASE = 0xffffffffu;
+
+	// Each level resolves 8 bits of the due time. Entries due more than 2^24 units ahead wait on the top level.
+	static constexpr unsigned LEVEL_BITS = 8, LEVELS = 3;
+	static constexpr unsigned BUCKETS = 1u << LEVEL_BITS;
+
+	// Create an entry for `target` that is due at `time`, at the next unit if that has passed.
+	Handle schedule(unsigned target, std::uint32_t time)
+	{
+		Handle handle;
+		if (free_handles.empty())
+		{
+			handle = static_cast<Handle>(entries.size());
+			entries.push_back(Entry{ target, 0 });
+		}
+		else
+		{
+			handle = free_handles.back();
+			free_handles.pop_back();
+		}
+		entries[handle].target = target;
+		entries[handle].time = std::max(time, current + 1);
+		insert(handle);
+		return handle;
+	}
+
+	// Drop the entry `handle`. Its handle is released once the entry comes due.
+	void cancel(Handle handle) { entries[handle].target = NO_TARGET; }
+
+	// Target of the entry `handle`, may be changed at any time.
+	unsigned& target(Handle handle) { return entries[handle].target; }
+
+	// Advance to `time` and call `fire(handle, target)` for every entry that comes due on the way.
+	// `fire` returns the time the entry is due again, or `RELEASE`.
+	template<typename Func>
+	void advance(std::uint32_t time, Func fire)
+	{
+		while (current != time)
+		{
+			++current;
+
+			// The next bucket of every level that starts a new revolution is spilled down, highest first.
+			for (unsigned level = LEVELS - 1; level > 0; --level)
+			{
+				if ((current & ((1u << (level * LEVEL_BITS)) - 1)) == 0)
+					spill(level, (current >> (level * LEVEL_BITS)) % BUCKETS);
+			}
+
+			due.swap(buckets[0][current % BUCKETS]);
+			for (Handle handle : due)
+			{
+				if (entries[handle].target == NO_TARGET)
+				{
+					free_handles.push_back(handle);
+					continue;
+				}
+
+				// `fire` may schedule new entries, so the entry is looked up again afterwards.
+				const std::uint32_t next_time = fire(handle, entries[handle].target);
+				if (next_time == RELEASE)
+				{
+					free_handles.push_back(handle);
+					continue;
+				}
+				entries[handle].time = std::max(next_time, current + 1);
+				insert(handle);
+			}
+			due.clear();
+		}
+	}
+
+	// Time the wheel has advanced to.
+	std::uint32_t now() const { return current; }
+
+private:
+	static constexpr unsigned NO_TARGET = 0xffffffffu;
+
+	struct Entry
+	{
+		unsigned target;
+		std::uint32_t time;
+	};
+
+	// Put `handle` into the bucket of the lowest level that shares the higher bits of its time with the current time.
+	void insert(Handle handle)
+	{
+		const std::uint32_t time = entries[handle].time;
+		unsigned level = 0;
+		while (level + 1 < LEVELS && (time >> ((level + 1) * LEVEL_BITS)) != (current >> ((level + 1) * LEVEL_BITS)))
+			++level;
+		buckets[level][(time >> (level * LEVEL_BITS)) % BUCKETS].push_back(handle);
+	}
+
+	// Redistribute the entries of a bucket that has come round to the levels below.
+	void spill(unsigned level, unsigned bucket)
+	{
+		std::vector<Handle> spilled;
+		spilled.swap(buckets[level][bucket]);
+		for (Handle handle : spilled)
+		{
+			if (entries[handle].target == NO_TARGET)
+				free_handles.push_back(handle);
+			else
+				insert(handle);
+		}
+	}
+
+	std::vector<Entry> entries;
+	std::vector<Handle> free_handles;
+	std::array<std::array<std::vector<Handle>, BUCKETS>, LEVELS> buckets;
+	std::vector<Handle> due;
+	std::uint32_t current = 0;
+};
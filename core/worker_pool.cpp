@@ -0,0 +1,77 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "worker_pool.hpp"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned size)
+	: Size{ size > 0 ? size : 1 }
+{
+	for (unsigned i = 1; i < Size; ++i)
+		threads.emplace_back([this, i] { work(i); });
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		shutdown = true;
+		++generation;
+	}
+	wake.notify_all();
+	std::for_each(threads.begin(), threads.end(), [](std::thread& th) { th.join(); });
+}
+
+void WorkerPool::run(const std::function<void(unsigned)>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		current_job = &job;
+		pending = Size - 1;
+		++generation;
+	}
+	wake.notify_all();
+	job(0);
+
+	std::unique_lock<std::mutex> lock{ mutex };
+	done.wait(lock, [this] { return pending == 0; });
+	current_job = nullptr;
+}
+
+void WorkerPool::work(unsigned worker_index)
+{
+	unsigned long long seen_generation = 0;
+	for (;;)
+	{
+		const std::function<void(unsigned)>* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			wake.wait(lock, [&] { return generation != seen_generation; });
+			seen_generation = generation;
+			if (shutdown)
+				return;
+			job = current_job;
+		}
+
+		(*job)(worker_index);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		if (--pending == 0)
+			done.notify_one();
+	}
+}
@@ -0,0 +1,57 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*-------------------------------------------------------------------.
+| Long-lived worker threads that are parked between dispatched jobs. |
+`-------------------------------------------------------------------*/
+struct WorkerPool
+{
+	// Number of workers including the calling thread.
+	const unsigned Size;
+
+	// Constructor. The calling thread acts as worker 0, so only `size - 1` threads are spawned.
+	explicit WorkerPool(unsigned size);
+
+	// Wake the parked workers one last time and let them exit.
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Execute `job(worker_index)` on every worker and block until all of them are finished.
+	void run(const std::function<void(unsigned)>& job);
+
+private:
+	// Loop of a single worker thread.
+	void work(unsigned worker_index);
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	const std::function<void(unsigned)>* current_job = nullptr;
+	unsigned long long generation = 0;
+	unsigned pending = 0;
+	bool shutdown = false;
+};
@@ -0,0 +1,633 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "world.hpp"
+
+// Colors of the terrain image.
+static const Color TILE_GRASS{ 0, 255, 0, 255 };
+static const Color TILE_WATER{ 0, 0, 255, 255 };
+
+Config default_config()
+{
+	return Config{ 
+		16,        // Increase aging by this factor for diseased people.
+		0.003f,    // Diseases a healthy person catches per simulated year, on average.
+		whole_years(2),    // The maximum time a disease can spread.
+		whole_years(3), whole_years(12),   // The minimum and maximum amount of time it takes a person to reproduce. 
+		40, 85,    // The smallest and largest possible strength value on startup.
+		5489,      // Seed of the random number generators.
+		false,     // Derive random draws from tick and field, independent of the number of workers.
+		Layout::Tiled,     // Order the population is stored in, tiles keep neighbours close in memory.
+		false      // Only update persons when their death or disease is due, from a timing wheel.
+	};
+}
+
+/*---------------------------------------------------------.
+| `config` with the three modes replaced. The fields of a  |
+| Config are constant, so every override builds a new one. |
+`---------------------------------------------------------*/
+static Config with_modes(const Config& config, bool counter_based_random, Layout field_layout, bool scheduled_events)
+{
+	return Config{
+		config.DiseasedAgingFactor, config.DiseasesPerYear, config.MaxLengthDisease,
+		config.MinYearsUntilReproduce, config.MaxYearsUntilReproduce,
+		config.MinStartStrength, config.MaxStartStrength,
+		config.RandomSeed, counter_based_random, field_layout, scheduled_events
+	};
+}
+
+Config with_counter_based_random(const Config& config, bool counter_based_random)
+{
+	return with_modes(config, counter_based_random, config.FieldLayout, config.ScheduledEvents);
+}
+
+Config with_layout(const Config& config, Layout field_layout)
+{
+	return with_modes(config, config.CounterBasedRandom, field_layout, config.ScheduledEvents);
+}
+
+Config with_scheduled_events(const Config& config, bool scheduled_events)
+{
+	return with_modes(config, config.CounterBasedRandom, config.FieldLayout, scheduled_events);
+}
+
+/*-------------------------------------------------------------------.
+| Randomly pick the position of a field next to the field at `x` and |
+| `y`, or of the field itself. On the edge of the map the neighbour  |
+| may be on the ghost border.                                        |
+`-------------------------------------------------------------------*/
+static unsigned random_destination(RandomStream& random, const Map& map, int x, int y)
+{
+	static const int STEP_X[5] = { 1, 0, -1,  0, 0 };
+	static const int STEP_Y[5] = { 0, 1,  0, -1, 0 };
+	const int direction = random.range(0, 4);
+	return map.position(x + STEP_X[direction], y + STEP_Y[direction]);
+}
+
+/*-----------------------------------------------------------------.
+| Randomly pick the healthy time until a person falls ill, for     |
+| `rate` diseases per year. Diseases strike independently of each  |
+| other, so the waiting time is exponentially distributed and the  |
+| countdown replaces a draw per person and step. The logarithm is  |
+| taken with integers, so every machine draws the same times.      |
+`-----------------------------------------------------------------*/
+static FixedYears random_time_until_disease(RandomStream& random, float rate)
+{
+	// A uniform draw from (0, 1] in steps of 2^-24, split into 2^exponent times a mantissa from [1, 2).
+	const std::uint32_t draw = static_cast<std::uint32_t>(random.range(1, 1 << 24));
+	unsigned exponent = 0;
+	while ((draw >> (exponent + 1)) != 0)
+		++exponent;
+
+	// Binary digits of log2 of the mantissa, by squaring it: each time the square reaches 2, the next digit is 1.
+	std::uint64_t mantissa = std::uint64_t{ draw } << (31 - exponent);    // 1 is 2^31.
+	std::uint32_t fraction = 0;
+	for (unsigned digit = 16; digit-- > 0;)
+	{
+		mantissa = (mantissa * mantissa) >> 31;
+		if (mantissa >> 32)
+		{
+			mantissa >>= 1;
+			fraction |= 1u << digit;
+		}
+	}
+
+	// -ln of the draw is -log2 * ln 2. The float operations are exactly rounded, which keeps them portable.
+	const std::uint32_t minus_log2 = ((24 - exponent) << 16) - fraction;    // 16.16 fixed point.
+	const float fixed = minus_log2 * (0.693147f * FIXED_YEARS_PER_YEAR / 65536.f) / rate;
+	return static_cast<FixedYears>(fixed >= 65535.f ? 65535.f : fixed + 0.5f);
+}
+
+/*-----------------------------------------.
+| Age at which the person at `slot` dies.  |
+`-----------------------------------------*/
+static FixedYears lifespan(const Map& map, unsigned slot)
+{
+	return whole_years(std::min<unsigned>(map.strength[slot], MAX_AGE));
+}
+
+World::World(const Config& config, unsigned width, unsigned height, const std::uint8_t* terrain_pixels, unsigned thread_count, CpuTier tier)
+	: config{ config },
+		map{ width, height, terrain_pixels, TILE_GRASS, TILE_WATER, config.FieldLayout },
+		random{ config.RandomSeed, 0 },
+		worker_pool{ thread_count },
+		kernels{ kernels_for(tier) },
+		stats(team_registry.size(), PopulationStats{ 0, 0, 0, 0 })
+{
+	// One independent random stream and statistics record per worker.
+	for (unsigned i = 0; i < worker_pool.Size; ++i)
+		workers.emplace_back(config.RandomSeed, i + 1, config.CounterBasedRandom);
+	map.scan_occupancy = kernels.scan_occupancy;
+
+	if (config.ScheduledEvents)
+	{
+		map.last_update.assign(map.land_cells.size(), 0);
+		map.event_handle.assign(map.land_cells.size(), TimingWheel::NO_HANDLE);
+	}
+}
+
+TeamIndex World::add_team(const std::string& name, const Color& color)
+{
+	const TeamIndex team = team_registry.add(name, color);
+	stats.resize(team_registry.size(), PopulationStats{ 0, 0, 0, 0 });
+	return team;
+}
+
+void World::spawn_tribe(int left, int top, int right, int bottom, TeamIndex team, unsigned total_population)
+{
+	for (unsigned i = 0; i < total_population; ++i)
+	{
+		const int x = random.range(left, right), y = random.range(top, bottom);
+		if (x < 0 || y < 0 || unsigned(x) >= map.Width || unsigned(y) >= map.Height)
+			continue;
+
+		const unsigned spawn_idx = map.index(x, y);
+		if (map.is_walkable(spawn_idx) && !(map.is_active(map.slot_of(spawn_idx))))
+		{
+			bool rand_sex = (bool)random.range(0, 2);
+			FixedYears rand_reproduction = whole_years(random.range(1, 20));
+			FixedYears rand_age = whole_years(random.range(1, 35));
+			int rand_strength = random.range(config.MinStartStrength, config.MaxStartStrength);
+			FixedYears rand_until_disease = random_time_until_disease(random, config.DiseasesPerYear);
+			map.store(map.slot_of(spawn_idx), { team, rand_sex, 0, rand_until_disease, rand_reproduction, rand_age, rand_strength });
+			map.paint_field(spawn_idx, team_registry);
+			if (config.ScheduledEvents)
+			{
+				map.last_update[map.slot_of(spawn_idx)] = simulated_time;
+				schedule_event(map.slot_of(spawn_idx));
+			}
+		}
+	}
+}
+
+void World::schedule_active_chunks()
+{
+	// A person moves one field per step at most, so only chunks next to a
+	// populated one can gain someone. All other chunks sleep.
+	active_chunks.clear();
+	std::size_t total_weight = 0;
+	for (unsigned cy = 0; cy < map.ChunksY; ++cy)
+	{
+		for (unsigned cx = 0; cx < map.ChunksX; ++cx)
+		{
+			bool is_active = false;
+			for (unsigned ny = (cy > 0 ? cy - 1 : 0); ny <= cy + 1 && ny < map.ChunksY && !is_active; ++ny)
+				for (unsigned nx = (cx > 0 ? cx - 1 : 0); nx <= cx + 1 && nx < map.ChunksX && !is_active; ++nx)
+					is_active = map.chunk_population[ny * map.ChunksX + nx].load(std::memory_order_relaxed) > 0;
+
+			if (is_active)
+			{
+				active_chunks.push_back(cy * map.ChunksX + cx);
+				total_weight += map.chunk_population[cy * map.ChunksX + cx].load(std::memory_order_relaxed) + 1;
+			}
+		}
+	}
+
+	// Give every worker a contiguous run of chunks with about the same population.
+	worker_chunks.assign(worker_pool.Size + 1, active_chunks.size());
+	worker_chunks[0] = 0;
+	std::size_t weight = 0;
+	unsigned worker_index = 1;
+	for (std::size_t i = 0; i < active_chunks.size() && worker_index < worker_pool.Size; ++i)
+	{
+		weight += map.chunk_population[active_chunks[i]].load(std::memory_order_relaxed) + 1;
+		while (worker_index < worker_pool.Size && weight * worker_pool.Size >= total_weight * worker_index)
+			worker_chunks[worker_index++] = i + 1;
+	}
+}
+
+void World::run_on_active_chunks(const std::function<void(WorkerContext&, unsigned)>& pass)
+{
+	worker_pool.run([&](unsigned worker_index) {
+		for (std::size_t i = worker_chunks[worker_index]; i < worker_chunks[worker_index + 1]; ++i)
+			pass(workers[worker_index], active_chunks[i]);
+	});
+}
+
+void World::step(const float DELTA, const bool RECORD_STATS)
+{
+	++update_counter;
+	schedule_active_chunks();
+	if (RECORD_STATS)
+	{
+		for (WorkerContext& worker : workers)
+			std::fill_n(worker.stats.begin(), std::min(team_registry.size(), worker.stats.size()), PopulationStats{ 0, 0, 0, 0 });
+	}
+
+	// Pass 1: Age the population. Only writes the person itself. The counters are updated by the aging
+	// kernel, the few persons that die, recover or fall ill are handled afterwards. With scheduled events
+	// only the persons whose death or disease is due are updated, and everybody else only for the statistics.
+	// The step is converted to whole FixedYears units and the rest carried over, so short steps add up exactly.
+	const std::uint64_t STEP_FRACTION = time_fraction + static_cast<std::uint64_t>(DELTA * (FIXED_YEARS_PER_YEAR * 65536.f) + 0.5f);
+	const std::uint32_t DELTA_FIXED = static_cast<std::uint32_t>(std::min<std::uint64_t>(STEP_FRACTION >> 16, 65535));
+	time_fraction = static_cast<std::uint32_t>(STEP_FRACTION & 65535);
+	if (config.ScheduledEvents)
+	{
+		simulated_time += DELTA_FIXED;
+		fire_due_events();
+	}
+	if (!(config.ScheduledEvents) || RECORD_STATS)
+	{
+		const AgingSlots AGING_SLOTS{ map.age.data(), map.disease.data(), map.until_disease.data(), map.reproduction.data(), map.is_male.data(), map.strength.data() };
+		const AgingStep AGING_STEP{ static_cast<std::uint16_t>(DELTA_FIXED), saturate_years(DELTA_FIXED * config.DiseasedAgingFactor) };
+		const StatsSlots STATS_SLOTS{ map.team.data(), map.strength.data(), map.age.data(), map.disease.data() };
+		run_on_active_chunks([&](WorkerContext& worker, unsigned chunk) {
+			// Record stats and age the persons 64 slots at a time. Blocks shared with the neighbouring range
+			// may be written by another worker, so only the scalar kernels run on those.
+			RandomStream& random = worker.random;
+			for (unsigned range = map.chunk_ranges[chunk]; range < map.chunk_ranges[chunk + 1]; ++range)
+			{
+				const Map::SlotRange slots = map.chunk_slots[range];
+				for (unsigned block = slots.begin / 64; block * 64 < slots.end; ++block)
+				{
+					std::uint64_t in_range = ~std::uint64_t{ 0 };
+					if (block * 64 < slots.begin)
+						in_range &= ~std::uint64_t{ 0 } << (slots.begin % 64);
+					if (slots.end - block * 64 < 64)
+						in_range &= (std::uint64_t{ 1 } << (slots.end % 64)) - 1;
+					const std::uint64_t occupied = map.occupancy[block].load(std::memory_order_relaxed) & in_range;
+					if (occupied == 0)
+						continue;
+
+					const bool WHOLE_BLOCK = (in_range == ~std::uint64_t{ 0 });
+
+					// Record stats.
+					if (RECORD_STATS)
+					{
+						if (config.ScheduledEvents)
+						{
+							for (std::uint64_t bits = occupied; bits != 0; bits &= bits - 1)
+								map.catch_up(block * 64 + lowest_set_bit(bits), simulated_time, config.DiseasedAgingFactor);
+						}
+						(WHOLE_BLOCK ? kernels.count_stats : count_stats_scalar)(STATS_SLOTS, block, occupied, worker.stats.data());
+					}
+					if (config.ScheduledEvents)
+						continue;
+
+					const AgingEvents events = (WHOLE_BLOCK ? kernels.age_block : age_block_scalar)(AGING_SLOTS, block, occupied, AGING_STEP);
+
+					// Died of old age.
+					for (std::uint64_t bits = events.died; bits != 0; bits &= bits - 1)
+					{
+						const unsigned slot = block * 64 + lowest_set_bit(bits);
+						map.vacate(slot);
+						worker.dirty_fields.push_back(map.land_cells[slot]);
+						worker.vacated_fields.push_back(slot);
+					}
+
+					// Recovered from a disease.
+					for (std::uint64_t bits = events.recovered; bits != 0; bits &= bits - 1)
+						worker.dirty_fields.push_back(map.land_cells[block * 64 + lowest_set_bit(bits)]);
+
+					// Caught a disease, which starts the wait for the next one.
+					for (std::uint64_t bits = events.fell_ill; bits != 0; bits &= bits - 1)
+					{
+						const unsigned slot = block * 64 + lowest_set_bit(bits);
+						const unsigned idx = map.land_cells[slot];
+						random.seek(update_counter, idx, UpdatePass::Age);
+						map.disease[slot] = static_cast<FixedYears>(random.range(whole_years(1), config.MaxLengthDisease));
+						map.until_disease[slot] = random_time_until_disease(random, config.DiseasesPerYear);
+						worker.dirty_fields.push_back(idx);
+					}
+				}
+			}
+		});
+	}
+
+	// Merge the statistics of all workers.
+	if (RECORD_STATS)
+	{
+		std::fill(stats.begin(), stats.end(), PopulationStats{ 0, 0, 0, 0 });
+		for (const WorkerContext& worker : workers)
+		{
+			for (std::size_t team = 0; team < std::min(stats.size(), worker.stats.size()); ++team)
+			{
+				stats[team].count_total += worker.stats[team].count_total;
+				stats[team].count_diseased += worker.stats[team].count_diseased;
+				stats[team].sum_strength += worker.stats[team].sum_strength;
+				stats[team].sum_age += worker.stats[team].sum_age;
+			}
+		}
+	}
+
+	// Empty fields are skipped, so the intents of fields left since the last plan are reset first.
+	worker_pool.run([&](unsigned worker_index) {
+		WorkerContext& worker = workers[worker_index];
+		for (unsigned slot : worker.vacated_fields)
+			map.intent_grid[slot] = { IntentType::Stay, 0, 0, slot };
+		worker.vacated_fields.clear();
+	});
+
+	// Pass 2: Every person writes down what it wants to do. Reads the grid, only writes intents.
+	run_on_active_chunks([&](WorkerContext& worker, unsigned chunk) {
+		RandomStream& random = worker.random;
+		map.for_each_occupied_in_chunk(chunk, [&](unsigned slot) {
+			const unsigned idx = map.land_cells[slot];
+			Intent& intent = map.intent_grid[slot];
+
+			// With scheduled events the counters are as of the last update, what they are now is worked out
+			// without writing them.
+			const std::uint32_t elapsed = (config.ScheduledEvents ? simulated_time - map.last_update[slot] : 0);
+			intent = { IntentType::Stay, map.strength[slot], count_down(map.disease[slot], elapsed), slot };
+			random.seek(update_counter, idx, UpdatePass::Plan);
+
+			// Calculate random neighbouring destination.
+			const int x = idx % map.Width, y = idx / map.Width;
+			const unsigned from = map.position(x, y), to = random_destination(random, map, x, y);
+
+			// Check the ground of the destination. The ghost border is never land.
+			if (to == from || !(map.is_land(to)))
+				return;
+
+			const unsigned target = map.slot_near(from, slot, to);
+			intent.destination = target;
+			if (!(map.is_active(target)))
+			{
+				// Give birth or walk to the destination if its not blocked by another person.
+				intent.type = (!(map.is_male[slot]) && count_down(map.reproduction[slot], elapsed) == 0 ? IntentType::Birth : IntentType::Move);
+			}
+			else if (map.team[target] == map.team[slot])
+			{
+				// Infect someone with a disease.
+				if (intent.disease > 0 && random.range(0, 2) == 1)
+					intent.type = IntentType::Infect;
+			}
+			else
+			{
+				// Fight an enemy.
+				intent.type = (map.strength[target] > intent.strength ? IntentType::FightLost : IntentType::FightWon);
+			}
+		});
+	});
+
+	// Pass 3: Winners of a free field move there or place a baby. Only writes fields that were free and the
+	// winners themselves, whose attributes no other person reads in this pass.
+	run_on_active_chunks([&](WorkerContext& worker, unsigned chunk) {
+		RandomStream& random = worker.random;
+		map.for_each_occupied_in_chunk(chunk, [&](unsigned slot) {
+			const unsigned idx = map.land_cells[slot];
+			const Intent& intent = map.intent_grid[slot];
+			if ((intent.type != IntentType::Move && intent.type != IntentType::Birth) || !map.wins_destination(slot))
+				return;
+
+			if (config.ScheduledEvents && intent.type == IntentType::Birth)
+				map.catch_up(slot, simulated_time, config.DiseasedAgingFactor);
+			Person person = map.load(slot);
+			random.seek(update_counter, idx, UpdatePass::Arrive);
+			if (intent.type == IntentType::Birth)
+			{
+				// Create baby at destination.
+				const int parent_strength = person.strength;
+				person.is_male = (bool)random.range(0, 2);
+				person.reproduction = static_cast<FixedYears>(random.range(config.MinYearsUntilReproduce, config.MaxYearsUntilReproduce));
+				person.strength = random.range((parent_strength > 15 ? parent_strength - 15 : 15), parent_strength + 30);
+				person.age = whole_years(1);
+				person.until_disease = random_time_until_disease(random, config.DiseasesPerYear);
+			}
+			map.store(intent.destination, person);
+			worker.dirty_fields.push_back(map.land_cells[intent.destination]);
+			if (config.ScheduledEvents)
+			{
+				// A mover takes its counters and pending event along, a baby gets its own after the update.
+				map.last_update[intent.destination] = map.last_update[slot];
+				if (intent.type == IntentType::Move)
+				{
+					event_wheel.target(map.event_handle[slot]) = intent.destination;
+					map.event_handle[intent.destination] = map.event_handle[slot];
+					map.event_handle[slot] = TimingWheel::NO_HANDLE;
+				}
+				else
+					worker.rescheduled_fields.push_back(intent.destination);
+			}
+
+			if (intent.type == IntentType::Move)
+			{
+				// Left the field.
+				map.vacate(slot);
+				worker.dirty_fields.push_back(idx);
+				worker.vacated_fields.push_back(slot);
+			}
+			else
+			{
+				// Reset reproduction rate.
+				random.seek(update_counter, idx, UpdatePass::Resolve);
+				map.reproduction[slot] = static_cast<FixedYears>(random.range(config.MinYearsUntilReproduce, config.MaxYearsUntilReproduce));
+			}
+		});
+	});
+
+	// Pass 4: Apply the outcome of fights to the acting and the targeted person. Only writes the field itself.
+	run_on_active_chunks([&](WorkerContext& worker, unsigned chunk) {
+		map.for_each_occupied_in_chunk(chunk, [&](unsigned slot) {
+			const unsigned idx = map.land_cells[slot];
+
+			// With scheduled events the counters are brought up to date before they change,
+			// and the next event is scheduled again afterwards.
+			bool changed = false;
+			const auto change = [&] {
+				if (config.ScheduledEvents && !changed)
+				{
+					map.catch_up(slot, simulated_time, config.DiseasedAgingFactor);
+					worker.rescheduled_fields.push_back(slot);
+				}
+				changed = true;
+			};
+
+			if (map.intent_grid[slot].type == IntentType::FightLost)
+			{
+				change();
+				map.age[slot] = whole_years(map.strength[slot]);
+			}
+
+			// Handle what the neighbours did to this person.
+			map.for_each_land_neighbour(idx, slot, [&](unsigned neighbour_slot) {
+				const Intent& incoming = map.intent_grid[neighbour_slot];
+				if (incoming.destination != slot)
+					return;
+				if (incoming.type == IntentType::Infect)
+				{
+					change();
+					if (map.disease[slot] == 0)
+						worker.dirty_fields.push_back(idx);
+					map.disease[slot] = incoming.disease;
+				}
+				else if (incoming.type == IntentType::FightWon)
+				{
+					change();
+					map.age[slot] = whole_years(incoming.strength);
+				}
+			});
+		});
+	});
+
+	if (config.ScheduledEvents)
+	{
+		for (WorkerContext& worker : workers)
+		{
+			for (unsigned slot : worker.rescheduled_fields)
+				schedule_event(slot);
+			worker.rescheduled_fields.clear();
+		}
+	}
+
+	paint_changed_fields();
+}
+
+std::uint32_t World::next_event_time(unsigned slot) const
+{
+	const FixedYears age = map.age[slot], death_age = lifespan(map, slot);
+	if (age >= death_age)
+		return simulated_time;
+
+	// A disease speeds up aging until it is over. A healthy person ages normally until it falls ill.
+	if (map.disease[slot] > 0)
+	{
+		const std::uint32_t rate = 1 + config.DiseasedAgingFactor;
+		const std::uint32_t until_death = (death_age - age + rate - 1) / rate;
+		return simulated_time + std::min<std::uint32_t>(until_death, map.disease[slot]);
+	}
+	return simulated_time + std::min<std::uint32_t>(death_age - age, map.until_disease[slot]);
+}
+
+void World::fire_due_events()
+{
+	// Events fire one after another on the calling thread, they only make up a small part of the population.
+	WorkerContext& worker = workers[0];
+	event_wheel.advance(simulated_time, [&](TimingWheel::Handle, unsigned slot) {
+		const unsigned idx = map.land_cells[slot];
+		const bool was_diseased = (map.disease[slot] > 0);
+		map.catch_up(slot, simulated_time, config.DiseasedAgingFactor);
+
+		// Died of old age.
+		if (map.age[slot] >= lifespan(map, slot))
+		{
+			map.vacate(slot);
+			map.intent_grid[slot] = { IntentType::Stay, 0, 0, slot };
+			map.event_handle[slot] = TimingWheel::NO_HANDLE;
+			worker.dirty_fields.push_back(idx);
+			return TimingWheel::RELEASE;
+		}
+
+		// Recovered from a disease, or caught a new one.
+		if (was_diseased && map.disease[slot] == 0)
+			worker.dirty_fields.push_back(idx);
+		if (map.disease[slot] == 0 && map.until_disease[slot] == 0)
+		{
+			worker.random.seek(update_counter, idx, UpdatePass::Age);
+			map.disease[slot] = static_cast<FixedYears>(worker.random.range(whole_years(1), config.MaxLengthDisease));
+			map.until_disease[slot] = random_time_until_disease(worker.random, config.DiseasesPerYear);
+			worker.dirty_fields.push_back(idx);
+		}
+		return next_event_time(slot);
+	});
+}
+
+void World::schedule_event(unsigned slot)
+{
+	TimingWheel::Handle& handle = map.event_handle[slot];
+	if (handle != TimingWheel::NO_HANDLE)
+		event_wheel.cancel(handle);
+	handle = event_wheel.schedule(slot, next_event_time(slot));
+}
+
+void World::repaint()
+{
+	// Colors of the teams, the one of NO_TEAM is never shown.
+	std::vector<std::uint8_t> palette(256 * 4, 0);
+	for (std::size_t team = 0; team < team_registry.size(); ++team)
+	{
+		const Color& color = team_registry[static_cast<TeamIndex>(team)].color;
+		palette[team * 4 + 0] = color.r;
+		palette[team * 4 + 1] = color.g;
+		palette[team * 4 + 2] = color.b;
+		palette[team * 4 + 3] = color.a;
+	}
+
+	std::vector<std::uint8_t> teams(map.Width), sick(map.Width), persons(std::size_t{ map.Width } * 4);
+	for (unsigned y = 0; y < map.Height; ++y)
+	{
+		// Who stands on the fields of the row.
+		for (unsigned x = 0; x < map.Width; ++x)
+		{
+			const unsigned position = map.position(x, y);
+			const bool is_land = map.is_land(position);
+			const unsigned slot = (is_land ? map.slot_at(position) : 0);
+			teams[x] = (is_land ? map.team[slot] : NO_TEAM);
+			sick[x] = (is_land && map.disease[slot] > 0);
+		}
+
+		// Their colors over the background.
+		const std::size_t row = std::size_t{ y } * map.Width * 4;
+		kernels.convert_palette(teams.data(), sick.data(), map.Width, palette.data(), persons.data());
+		kernels.compose(persons.data(), teams.data(), &map.background[row], map.Width, &map.image_buffer[row]);
+		map.dirty_rows[y] = Map::RowSpan{ 0, map.Width };
+	}
+}
+
+void World::paint_changed_fields()
+{
+	for (WorkerContext& worker : workers)
+	{
+		if (painting)
+		{
+			for (unsigned idx : worker.dirty_fields)
+				map.paint_field(idx, team_registry);
+		}
+		worker.dirty_fields.clear();
+	}
+}
+
+void create_test_tribes(World& world)
+{
+	// Define teams.
+	const TeamIndex TEAM_RED    = world.add_team("Red",    Color{ 255,   0,   0, 255 });
+	[[maybe_unused]] const TeamIndex TEAM_YELLOW = world.add_team("Yellow", Color{ 255, 200,   0, 255 });
+	[[maybe_unused]] const TeamIndex TEAM_VIOLET = world.add_team("Violet", Color{ 128,   0, 255, 255 });
+	const TeamIndex TEAM_BLUE   = world.add_team("Blue",   Color{   0, 128, 255, 255 });
+
+	// Define starting positions for each team.
+	world.spawn_tribe(380,  60, 400,  80, TEAM_RED,  50);
+	world.spawn_tribe(400, 110, 420, 130, TEAM_BLUE, 50);
+	//world.spawn_tribe( 50,  20, 500,  95, TEAM_RED,    500000);
+	//world.spawn_tribe( 50,  95, 500, 150, TEAM_YELLOW, 500000);
+	//world.spawn_tribe(100, 150, 500, 220, TEAM_VIOLET, 500000);
+	//world.spawn_tribe(100, 220, 500, 310, TEAM_BLUE,   500000);
+}
+
+std::string population_statistics_to_string(const std::vector<PopulationStats>& population_stats, const TeamRegistry& teams)
+{
+	std::string text;
+	for (std::size_t team = 1; team < teams.size(); ++team)
+	{
+		const PopulationStats& stats = population_stats[team];
+
+		// Calculate averages of strength and age.
+		const unsigned alive_total = stats.count_total;
+		const unsigned avg_str = stats.sum_strength / (alive_total > 0 ? alive_total : 1);
+		const unsigned avg_age = stats.sum_age / (alive_total > 0 ? alive_total : 1);
+
+		// Pad team names to a common width.
+		std::string label = teams[static_cast<TeamIndex>(team)].name + ":";
+		label.resize(std::max<std::size_t>(label.size() + 1, 8), ' ');
+
+		text += label + "Alive(" + std::to_string(alive_total) +
+			") Sick(" + std::to_string(stats.count_diseased) +
+			") AvgAge(" + std::to_string(avg_age) +
+			") AvgStr(" + std::to_string(avg_str) + ")\n";
+	}
+	return text;
+}
@@ -0,0 +1,756 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <atomic>
+
+#include "random.hpp"
+#include "worker_pool.hpp"
+#include "timing_wheel.hpp"
+#include "kernels.hpp"
+
+/*-------------------------------------------------------.
+| Simulated time as a fixed-point number of 1/256 years. |
+| Every time counter of the simulation is kept in these  |
+| units and updated with integer arithmetic only, so a   |
+| run gives the same result on every machine.            |
+`-------------------------------------------------------*/
+typedef std::uint16_t FixedYears;
+const unsigned FIXED_YEARS_PER_YEAR = 256;
+
+// `years` whole years.
+constexpr FixedYears whole_years(unsigned years)
+{
+	return static_cast<FixedYears>(years * FIXED_YEARS_PER_YEAR);
+}
+
+// Persons die at the latest at this age, in years.
+const unsigned MAX_AGE = 85;
+
+// `fixed` capped at the longest time a counter can hold.
+inline FixedYears saturate_years(std::uint32_t fixed)
+{
+	return static_cast<FixedYears>(std::min<std::uint32_t>(fixed, 65535));
+}
+
+// What is left of the counter `fixed` after `elapsed` units.
+inline FixedYears count_down(FixedYears fixed, std::uint32_t elapsed)
+{
+	return static_cast<FixedYears>(fixed > elapsed ? fixed - elapsed : 0);
+}
+
+/*---------------------------------------------------------------------.
+| Class of the ground a field is made of. Only grass can be walked on. |
+`---------------------------------------------------------------------*/
+enum class Terrain : std::uint8_t
+{
+	Water,
+	Grass,
+	Other
+};
+
+/*----------------------------------------------------------.
+| Position of the lowest set bit, `bits` must not be zero.  |
+`----------------------------------------------------------*/
+inline unsigned lowest_set_bit(std::uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long position;
+	_BitScanForward64(&position, bits);
+	return static_cast<unsigned>(position);
+#else
+	return static_cast<unsigned>(__builtin_ctzll(bits));
+#endif
+}
+
+/*------------------------------.
+| Number of bits set in `bits`. |
+`------------------------------*/
+inline unsigned count_set_bits(std::uint64_t bits)
+{
+#if defined(_MSC_VER)
+	return static_cast<unsigned>(__popcnt64(bits));
+#elif defined(__POPCNT__)
+	return static_cast<unsigned>(__builtin_popcountll(bits));
+#else
+	// Without the instruction the builtin is a library call, counting in registers is faster.
+	bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+	bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+	bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return static_cast<unsigned>((bits * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/*-----------------------------------------------------------------.
+| Spread the lower 16 bits of `value` to the even bits of a 32-bit |
+| word, so that two coordinates interleave to a Z-order index.     |
+`-----------------------------------------------------------------*/
+inline std::uint32_t spread_bits(std::uint32_t value)
+{
+	value &= 0x0000ffff;
+	value = (value | (value << 8)) & 0x00ff00ff;
+	value = (value | (value << 4)) & 0x0f0f0f0f;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+/*------------------------------------------------------------------.
+| Order in which the fields of the map are stored. Fields above and |
+| below are a whole map row apart in row-major order, but only a    |
+| chunk row apart in a tile, so a tile stays in the cache while it  |
+| is updated. Z-order keeps every aligned square contiguous.        |
+`------------------------------------------------------------------*/
+enum class Layout : std::uint8_t
+{
+	RowMajor,   // Row by row across the whole map.
+	Tiled,      // Chunk by chunk, row by row within a chunk.
+	Morton      // Along the Z-order curve of x and y.
+};
+
+/*------------------------------------.
+| Index of a team, 0 marks no person. |
+`------------------------------------*/
+typedef std::uint8_t TeamIndex;
+const TeamIndex NO_TEAM = 0;
+
+// Most teams that can be registered, `NO_TEAM` not counted.
+const std::size_t MAX_TEAMS = 255;
+
+/*--------------------------------.
+| An RGBA color of the map image. |
+`--------------------------------*/
+struct Color
+{
+	std::uint8_t r, g, b, a;
+
+	bool operator==(const Color& other) const { return r == other.r && g == other.g && b == other.b && a == other.a; }
+};
+
+/*-----------------------------------.
+| A single entity of the population. |
+`-----------------------------------*/
+struct Person
+{
+	TeamIndex team;
+	bool is_male;
+	FixedYears disease;
+	FixedYears until_disease;    // Healthy time left until the person falls ill by itself.
+	FixedYears reproduction;
+	FixedYears age;
+	int strength;
+};
+
+/*-------------------------------------------------------.
+| What a person tries to do with its neighbouring field. |
+`-------------------------------------------------------*/
+enum class IntentType : std::uint8_t
+{
+	Stay,       // Nothing to do with the destination.
+	Move,       // Walk to the free destination.
+	Birth,      // Place a baby on the free destination.
+	Infect,     // Pass the disease on to a team member at the destination.
+	FightWon,   // Attack a weaker enemy at the destination.
+	FightLost   // Attack a stronger enemy at the destination.
+};
+
+/*---------------------------------------------------------------.
+| Recorded in the first phase of an update, resolved afterwards. |
+`---------------------------------------------------------------*/
+struct Intent
+{
+	IntentType type;
+	std::uint8_t strength;
+	FixedYears disease;
+	unsigned destination;    // Slot of the targeted land field.
+};
+
+/*--------------------------------------.
+| Records statistics on the population. |
+`--------------------------------------*/
+struct PopulationStats
+{
+	int count_total;
+	int count_diseased;
+	int sum_strength;
+	int sum_age;
+};
+
+/*----------------------------------------------------------.
+| Assigns dense indices to the teams at startup. Per-team   |
+| data is stored in plain arrays indexed by the team index. |
+`----------------------------------------------------------*/
+struct TeamRegistry
+{
+	struct Team
+	{
+		std::string name;
+		Color color;
+	};
+
+	// All registered teams, starting with `NO_TEAM`.
+	std::vector<Team> teams{ Team{ "", Color{ 255, 255, 255, 255 } } };
+
+	// Register a new team and return its index. Throws std::length_error if `MAX_TEAMS` are registered already.
+	TeamIndex add(const std::string& name, const Color& color)
+	{
+		if (teams.size() > MAX_TEAMS)
+			throw std::length_error{ "No more than " + std::to_string(MAX_TEAMS) + " teams can be registered" };
+		teams.push_back(Team{ name, color });
+		return static_cast<TeamIndex>(teams.size() - 1);
+	}
+
+	// Number of teams, `NO_TEAM` included.
+	std::size_t size() const { return teams.size(); }
+
+	const Team& operator[](TeamIndex index) const { return teams[index]; }
+};
+
+/*--------------------------------------------------------------.
+| Handles the population and draws updates to the image-buffer. |
+| Persons can only stand on land, so only land fields get       |
+| storage: each one is given a dense slot in layout order and a |
+| land bitmap with a running count per word turns a field into  |
+| its slot with one popcount. The population is stored as one   |
+| array per attribute of `Person`, indexed by slot, so passes   |
+| only stream through the fields they need. Attributes are      |
+| quantized to 11 bytes per slot: team, sex and strength take a |
+| byte each, the time counters are FixedYears. An occupancy     |
+| bitmap mirrors `team != NO_TEAM` with one bit per slot, so    |
+| passes skip empty land 64 slots at a time. The map is also    |
+| divided into chunks that count their population, so whole     |
+| empty regions can be skipped. The chunks are also the tiles   |
+| of the tiled layout. The storage order includes a ghost       |
+| border of one field around the map that is never land, so     |
+| neighbours can be looked up without checking the edges.       |
+`--------------------------------------------------------------*/
+struct Map
+{
+	// Columns [begin, end) of a row painted since the last upload, empty if `begin >= end`.
+	struct RowSpan
+	{
+		unsigned begin, end;
+	};
+
+	// Edge length of a chunk in fields.
+	static constexpr unsigned CHUNK_SIZE = 64;
+
+	// Properties.
+	const unsigned Width, Height;
+	const unsigned TotalCells;
+	const unsigned ChunksX, ChunksY;
+	const Layout FieldLayout;
+
+	// Number of positions in the storage order, including the ghost border and the padding of tiles and Z-order.
+	unsigned TotalPositions = 0;
+
+	// Position of the field at `x` and `y` is row_positions[y + 1] + column_positions[x + 1].
+	std::vector<unsigned> row_positions, column_positions;
+
+	// 64 fields of the land bitmap, together with the number of land fields before them.
+	struct LandWord
+	{
+		std::uint64_t bits;
+		unsigned rank;
+	};
+
+	// Slots [begin, end) of a part of a chunk.
+	struct SlotRange
+	{
+		unsigned begin, end;
+	};
+
+	// One bit per position, set if the field there is land. Ends with an empty word, so every position
+	// up to `TotalPositions` has a slot.
+	std::vector<LandWord> land;
+
+	// Field of every slot.
+	std::vector<unsigned> land_cells;
+
+	// Slots of each chunk: one range per row in row-major order, a single one in the other layouts.
+	// Chunk `c` owns chunk_slots[chunk_ranges[c], chunk_ranges[c + 1]).
+	std::vector<SlotRange> chunk_slots;
+	std::vector<unsigned> chunk_ranges;
+
+	// Population of the land slots.
+	std::vector<TeamIndex> team;
+	std::vector<std::uint8_t> is_male;
+	std::vector<std::uint8_t> strength;
+	std::vector<FixedYears> disease;
+	std::vector<FixedYears> until_disease;    // Saturates after 256 years, longer than anybody lives.
+	std::vector<FixedYears> reproduction;
+	std::vector<FixedYears> age;
+	std::vector<Intent> intent_grid;
+
+	// With scheduled events, the time the counters of each slot were last brought up to date
+	// and the pending event of its person. Empty otherwise.
+	std::vector<std::uint32_t> last_update;
+	std::vector<TimingWheel::Handle> event_handle;
+
+	// One bit per slot, set if a person stands there. Words are atomic, as the
+	// ranges of two workers can share one.
+	std::vector<std::atomic<std::uint64_t>> occupancy;
+
+	// Turns a word of the occupancy bitmap into the slots of its persons, set to the kernel of the world's tier.
+	OccupancyScanKernel scan_occupancy = scan_occupancy_scalar;
+
+	// Number of persons in each chunk, row by row.
+	std::vector<std::atomic<int>> chunk_population;
+
+	// Grid display, 4 bytes RGBA per field.
+	std::vector<std::uint8_t> background;
+	std::vector<std::uint8_t> image_buffer;
+	std::vector<RowSpan> dirty_rows;
+
+	// Constructor. Takes the RGBA `pixels` as background and classifies each of them as grass, water or other terrain.
+	// The population is stored in the order of `layout`.
+	Map(unsigned width, unsigned height, const std::uint8_t* pixels, const Color& grass_color, const Color& water_color, Layout layout)
+		: Width{ width }, 
+			Height{ height }, 
+			TotalCells{ Width*Height }, 
+			ChunksX{ (Width + 2 + CHUNK_SIZE - 1) / CHUNK_SIZE },
+			ChunksY{ (Height + 2 + CHUNK_SIZE - 1) / CHUNK_SIZE },
+			FieldLayout{ layout },
+			chunk_population(ChunksX * ChunksY),
+			background(pixels, pixels + std::size_t{ TotalCells } * 4),
+			image_buffer(background),
+			dirty_rows(Height, RowSpan{ width, 0 })
+	{
+		// Storage order of the map and its ghost border, split into a part for the column and one for the row.
+		const unsigned PADDED_WIDTH = Width + 2, PADDED_HEIGHT = Height + 2;
+		for (unsigned x = 0; x < PADDED_WIDTH; ++x)
+		{
+			switch (FieldLayout)
+			{
+			case Layout::Tiled:  column_positions.push_back((x / CHUNK_SIZE) * CHUNK_SIZE * CHUNK_SIZE + x % CHUNK_SIZE); break;
+			case Layout::Morton: column_positions.push_back(spread_bits(x));                                       break;
+			default:             column_positions.push_back(x);                                                    break;
+			}
+		}
+		for (unsigned y = 0; y < PADDED_HEIGHT; ++y)
+		{
+			switch (FieldLayout)
+			{
+			case Layout::Tiled:  row_positions.push_back((y / CHUNK_SIZE) * ChunksX * CHUNK_SIZE * CHUNK_SIZE + (y % CHUNK_SIZE) * CHUNK_SIZE); break;
+			case Layout::Morton: row_positions.push_back(spread_bits(y) << 1);                                                              break;
+			default:             row_positions.push_back(y * PADDED_WIDTH);                                                                 break;
+			}
+		}
+
+		// Positions covered by each chunk. Chunks start at the ghost border, so the first
+		// ones contain a column or row less of the map. Tiles and aligned Z-order squares
+		// are contiguous, rows are not.
+		for (unsigned chunk = 0; chunk < ChunksX * ChunksY; ++chunk)
+		{
+			const unsigned x = (chunk % ChunksX) * CHUNK_SIZE, y = (chunk / ChunksX) * CHUNK_SIZE;
+			chunk_ranges.push_back(static_cast<unsigned>(chunk_slots.size()));
+			if (FieldLayout == Layout::RowMajor)
+			{
+				for (unsigned row = y; row < std::min(y + CHUNK_SIZE, PADDED_HEIGHT); ++row)
+					chunk_slots.push_back(SlotRange{ row_positions[row] + x, row_positions[row] + std::min(x + CHUNK_SIZE, PADDED_WIDTH) });
+			}
+			else
+				chunk_slots.push_back(SlotRange{ row_positions[y] + column_positions[x], row_positions[y] + column_positions[x] + CHUNK_SIZE * CHUNK_SIZE });
+			TotalPositions = std::max(TotalPositions, chunk_slots.back().end);
+		}
+		chunk_ranges.push_back(static_cast<unsigned>(chunk_slots.size()));
+
+		// Mark the land and number it in storage order.
+		land.assign((TotalPositions + 63) / 64 + 1, LandWord{ 0, 0 });
+		for (unsigned idx = 0; idx < TotalCells; ++idx)
+		{
+			const std::uint8_t* pixel = &background[std::size_t{ idx } * 4];
+			const Color color{ pixel[0], pixel[1], pixel[2], pixel[3] };
+			const Terrain terrain = (color == grass_color ? Terrain::Grass : (color == water_color ? Terrain::Water : Terrain::Other));
+			if (terrain == Terrain::Grass)
+				land[position_of(idx) / 64].bits |= std::uint64_t{ 1 } << (position_of(idx) % 64);
+		}
+		for (std::size_t word = 1; word < land.size(); ++word)
+			land[word].rank = land[word - 1].rank + count_set_bits(land[word - 1].bits);
+		land_cells.resize(land.back().rank);
+		for (unsigned idx = 0; idx < TotalCells; ++idx)
+		{
+			if (is_walkable(idx))
+				land_cells[slot_of(idx)] = idx;
+		}
+		for (SlotRange& range : chunk_slots)
+			range = SlotRange{ slot_at(range.begin), slot_at(range.end) };
+
+		const std::size_t land_size = land_cells.size();
+		team.assign(land_size, NO_TEAM);
+		is_male.assign(land_size, false);
+		strength.assign(land_size, 0);
+		disease.assign(land_size, 0);
+		until_disease.assign(land_size, 0);
+		reproduction.assign(land_size, 0);
+		age.assign(land_size, 0);
+		intent_grid.resize(land_size);
+		for (unsigned slot = 0; slot < land_size; ++slot)
+			intent_grid[slot] = { IntentType::Stay, 0, 0, slot };
+		occupancy = std::vector<std::atomic<std::uint64_t>>((land_size + 63) / 64);
+	}
+
+	// Position of the field at `x` and `y` in the storage order. Both may be one field outside of
+	// the map, on the ghost border.
+	unsigned position(int x, int y) const { return row_positions[y + 1] + column_positions[x + 1]; }
+
+	// Position of the field at `idx` in the storage order.
+	unsigned position_of(unsigned idx) const { return position(idx % Width, idx / Width); }
+
+	// Whether the field at `position` is land.
+	bool is_land(unsigned position) const { return (land[position / 64].bits >> (position % 64)) & 1; }
+
+	// Slot of the land field at `position`. For any other position, the number of land fields before it.
+	unsigned slot_at(unsigned position) const
+	{
+		const LandWord& word = land[position / 64];
+		return word.rank + count_set_bits(word.bits & ((std::uint64_t{ 1 } << (position % 64)) - 1));
+	}
+
+	// Slot of the land field at position `to`, next to the land field at position `from` and `slot`.
+	// Land positions next to each other have consecutive slots, others need a lookup.
+	unsigned slot_near(unsigned from, unsigned slot, unsigned to) const
+	{
+		return (to == from + 1 ? slot + 1 : (to + 1 == from ? slot - 1 : slot_at(to)));
+	}
+
+	// Whether a person can stand on the field at `idx`.
+	bool is_walkable(unsigned idx) const { return is_land(position_of(idx)); }
+
+	// Slot of the land field at `idx`.
+	unsigned slot_of(unsigned idx) const { return slot_at(position_of(idx)); }
+
+	// Repaint the field at `idx` with its person, or with the background if nobody stands there.
+	void paint_field(unsigned idx, const TeamRegistry& teams)
+	{
+		const unsigned x = idx % Width, y = idx / Width;
+		dirty_rows[y].begin = std::min(dirty_rows[y].begin, x);
+		dirty_rows[y].end = std::max(dirty_rows[y].end, x + 1);
+
+		std::uint8_t* pixel = &image_buffer[std::size_t{ idx } * 4];
+		const unsigned position = position_of(idx);
+		if (!(is_land(position)) || !(is_active(slot_at(position))))
+		{
+			std::copy_n(&background[std::size_t{ idx } * 4], 4, pixel);
+			return;
+		}
+
+		// Set different color if diseased.
+		const unsigned slot = slot_at(position);
+		const Color& color = teams[team[slot]].color;
+		pixel[0] = color.r;
+		pixel[1] = color.g;
+		pixel[2] = color.b;
+		pixel[3] = (disease[slot] > 0 ? 160 : color.a);
+	}
+
+	// Call `upload(x, y, width, pixels)` with the part of every row painted since the last call.
+	// Returns the number of passed bytes.
+	template<typename Func>
+	std::size_t flush_dirty_rows(Func upload)
+	{
+		std::size_t uploaded_bytes = 0;
+		for (unsigned y = 0; y < Height; ++y)
+		{
+			RowSpan& span = dirty_rows[y];
+			if (span.begin >= span.end)
+				continue;
+
+			upload(span.begin, y, span.end - span.begin, &image_buffer[(std::size_t{ y } * Width + span.begin) * 4]);
+			uploaded_bytes += std::size_t{ span.end - span.begin } * 4;
+			span = RowSpan{ Width, 0 };
+		}
+		return uploaded_bytes;
+	}
+
+	// Chunk the field at `idx` belongs to. Chunks are aligned to the ghost border.
+	unsigned chunk_of(unsigned idx) const { return ((idx / Width + 1) / CHUNK_SIZE) * ChunksX + (idx % Width + 1) / CHUNK_SIZE; }
+
+	// Remove the person at `slot` from the grid.
+	void vacate(unsigned slot)
+	{
+		team[slot] = NO_TEAM;
+		const std::uint64_t bit = std::uint64_t{ 1 } << (slot % 64);
+		if (occupancy[slot / 64].fetch_and(~bit, std::memory_order_relaxed) & bit)
+			chunk_population[chunk_of(land_cells[slot])].fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// Call `func(slot)` for every occupied slot from `from_slot` to `to_slot`, in ascending order.
+	// Slots that become occupied during the scan may or may not be visited.
+	template<typename Func>
+	void for_each_occupied(unsigned from_slot, unsigned to_slot, Func func) const
+	{
+		unsigned slots[64];
+		for (unsigned word = from_slot / 64; word * 64 < to_slot; ++word)
+		{
+			std::uint64_t bits = occupancy[word].load(std::memory_order_relaxed);
+			if (word * 64 < from_slot)
+				bits &= ~std::uint64_t{ 0 } << (from_slot % 64);
+			if (to_slot - word * 64 < 64)
+				bits &= (std::uint64_t{ 1 } << (to_slot % 64)) - 1;
+			if (bits == 0)
+				continue;
+
+			const unsigned count = scan_occupancy(bits, word * 64, slots);
+			for (unsigned i = 0; i < count; ++i)
+				func(slots[i]);
+		}
+	}
+
+	// Call `func(slot)` for every occupied land field of `chunk`, in storage order.
+	template<typename Func>
+	void for_each_occupied_in_chunk(unsigned chunk, Func func) const
+	{
+		for (unsigned range = chunk_ranges[chunk]; range < chunk_ranges[chunk + 1]; ++range)
+			for_each_occupied(chunk_slots[range].begin, chunk_slots[range].end, func);
+	}
+
+	// Index of the field at `x` and `y`.
+	unsigned index(unsigned x, unsigned y) const { return y * Width + x; }
+
+	// Access to the quantized attributes of the person at `slot`.
+	bool is_active(unsigned slot) const { return team[slot] != NO_TEAM; }
+	void set_strength(unsigned slot, int value) { strength[slot] = static_cast<std::uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value)); }
+
+	// Bring the counters of the person at `slot` up to the time `now`, for scheduled events. A disease that
+	// ran out in between only sped up aging until it ended.
+	void catch_up(unsigned slot, std::uint32_t now, unsigned diseased_aging_factor)
+	{
+		const std::uint32_t elapsed = now - last_update[slot];
+		if (elapsed == 0)
+			return;
+
+		const std::uint32_t ill = std::min<std::uint32_t>(disease[slot], elapsed);
+		age[slot] = saturate_years(age[slot] + elapsed + ill * diseased_aging_factor);
+		disease[slot] = count_down(disease[slot], ill);
+		until_disease[slot] = count_down(until_disease[slot], elapsed - ill);
+		if (!(is_male[slot]))
+			reproduction[slot] = count_down(reproduction[slot], elapsed);
+		last_update[slot] = now;
+	}
+
+	// Gather the person at `slot` from the attribute arrays.
+	Person load(unsigned slot) const
+	{
+		return { team[slot], is_male[slot] != 0, disease[slot], until_disease[slot], reproduction[slot], age[slot], strength[slot] };
+	}
+
+	// Scatter `p` into the attribute arrays at `slot`.
+	void store(unsigned slot, const Person& p)
+	{
+		if (p.team == NO_TEAM)
+		{
+			vacate(slot);
+			return;
+		}
+		team[slot] = p.team;
+		const std::uint64_t bit = std::uint64_t{ 1 } << (slot % 64);
+		if (!(occupancy[slot / 64].fetch_or(bit, std::memory_order_relaxed) & bit))
+			chunk_population[chunk_of(land_cells[slot])].fetch_add(1, std::memory_order_relaxed);
+		is_male[slot] = p.is_male;
+		disease[slot] = p.disease;
+		until_disease[slot] = p.until_disease;
+		reproduction[slot] = p.reproduction;
+		age[slot] = p.age;
+		set_strength(slot, p.strength);
+	}
+
+	// Call `func(neighbour_slot)` for the land fields above, below, left and right of the land field `idx` at `slot`.
+	// Fields on the edge of the map have the ghost border as neighbour, which is never land.
+	template<typename Func>
+	void for_each_land_neighbour(unsigned idx, unsigned slot, Func func) const
+	{
+		const int x = idx % Width, y = idx / Width;
+		const unsigned from = position(x, y);
+		const auto visit = [&](unsigned to) {
+			if (is_land(to))
+				func(slot_near(from, slot, to));
+		};
+		visit(position(x - 1, y));
+		visit(position(x + 1, y));
+		visit(position(x, y - 1));
+		visit(position(x, y + 1));
+	}
+
+	// Whether the move or birth intended at `slot` gets the destination field.
+	// Of all persons heading for the same free field the one with the lowest field index wins, in any layout.
+	bool wins_destination(unsigned slot) const
+	{
+		const unsigned destination = intent_grid[slot].destination;
+		bool wins = true;
+		for_each_land_neighbour(land_cells[destination], destination, [&](unsigned rival_slot) {
+			const Intent& rival = intent_grid[rival_slot];
+			if (rival.destination == destination && (rival.type == IntentType::Move || rival.type == IntentType::Birth) &&
+				land_cells[rival_slot] < land_cells[slot])
+				wins = false;
+		});
+		return wins;
+	}
+};
+
+/*----------------------------------------------------.
+| Specifies the numeric properties of the simulation. |
+`----------------------------------------------------*/
+struct Config
+{
+	const unsigned DiseasedAgingFactor;
+	const float DiseasesPerYear;
+	const FixedYears MaxLengthDisease;
+	const FixedYears MinYearsUntilReproduce, MaxYearsUntilReproduce;
+	const unsigned MinStartStrength, MaxStartStrength;
+	const unsigned RandomSeed;
+	const bool CounterBasedRandom;
+	const Layout FieldLayout;
+	const bool ScheduledEvents;
+};
+
+// The configuration the executables start with.
+Config default_config();
+
+// `config` with a different random mode, storage layout or event mode.
+Config with_counter_based_random(const Config& config, bool counter_based_random);
+Config with_layout(const Config& config, Layout field_layout);
+Config with_scheduled_events(const Config& config, bool scheduled_events);
+
+/*------------------------------------------------------------------.
+| State owned by a single worker. Aligned to cache lines, so that   |
+| workers never write to the same line while counting statistics.   |
+`------------------------------------------------------------------*/
+struct alignas(64) WorkerContext
+{
+	// Constructor.
+	WorkerContext(unsigned seed, unsigned stream_index, bool counter_based)
+		: random{ seed, stream_index, counter_based }
+	{}
+
+	RandomStream random;
+
+	// Statistics indexed by team, a record for every TeamIndex the registry can hand out.
+	std::array<PopulationStats, MAX_TEAMS + 1> stats{};
+
+	// Fields whose pixel changed during the current update.
+	std::vector<unsigned> dirty_fields;
+
+	// Fields of the worker's range that were left since their intents were last written.
+	std::vector<unsigned> vacated_fields;
+
+	// Slots whose next event has to be scheduled again after the update.
+	std::vector<unsigned> rescheduled_fields;
+};
+
+/*--------------------------------------------------------------.
+| The simulation without any window. Owns the map, the teams    |
+| and the workers, and advances the population with `step()`.   |
+`--------------------------------------------------------------*/
+struct World
+{
+	// Constructor. `terrain_pixels` holds `width * height` RGBA pixels: green is land, blue is water.
+	// The hot loops run the kernels of `tier`, which the processor has to support.
+	World(const Config& config, unsigned width, unsigned height, const std::uint8_t* terrain_pixels,
+		unsigned thread_count = std::thread::hardware_concurrency(), CpuTier tier = detect_cpu_tier());
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	// Register a new team and return its index. At most `MAX_TEAMS` teams fit, the next one throws std::length_error.
+	TeamIndex add_team(const std::string& name, const Color& color);
+
+	// Place up to `total_population` persons of `team` on free land from `left`, `top` to `right`, `bottom`.
+	void spawn_tribe(int left, int top, int right, int bottom, TeamIndex team, unsigned total_population);
+
+	// Advance the population by `delta` years. Statistics are only counted if `record_stats` is set.
+	void step(float delta, bool record_stats);
+
+	// Whether `step()` keeps the image up to date. Fields changed while disabled are not repainted.
+	void set_painting(bool enabled) { painting = enabled; }
+
+	// Paint the whole image from scratch, e.g. after painting was disabled.
+	void repaint();
+
+	// Call `upload(x, y, width, pixels)` with the RGBA pixels of every row part painted since the last call.
+	// Returns the number of passed bytes.
+	template<typename Func>
+	std::size_t flush_dirty_rows(Func upload) { return map.flush_dirty_rows(upload); }
+
+	unsigned width() const { return map.Width; }
+	unsigned height() const { return map.Height; }
+	std::uint64_t tick() const { return update_counter; }
+	unsigned thread_count() const { return worker_pool.Size; }
+	CpuTier kernel_tier() const { return kernels.tier; }
+
+	// Current image of the map, 4 bytes RGBA per field.
+	const std::vector<std::uint8_t>& pixels() const { return map.image_buffer; }
+
+	// Statistics of each team as of the last step that recorded them.
+	const std::vector<PopulationStats>& population_stats() const { return stats; }
+	const TeamRegistry& teams() const { return team_registry; }
+
+private:
+	// Collect the chunks that have a population or border one and split them among the workers.
+	void schedule_active_chunks();
+
+	// Run `pass(worker, chunk)` on each scheduled chunk and wait for completion.
+	void run_on_active_chunks(const std::function<void(WorkerContext&, unsigned)>& pass);
+
+	// Repaint the fields that changed, restoring the background under vacated ones.
+	void paint_changed_fields();
+
+	// Time the next event of the person at `slot` is due: its death, or the start or end of a disease.
+	std::uint32_t next_event_time(unsigned slot) const;
+
+	// Update the persons whose next event is due by `simulated_time`.
+	void fire_due_events();
+
+	// Schedule the next event of the person at `slot`, replacing a pending one.
+	void schedule_event(unsigned slot);
+
+	const Config config;
+	Map map;
+	TeamRegistry team_registry;
+	RandomStream random;
+	WorkerPool worker_pool;
+	std::vector<WorkerContext> workers;
+	const Kernels kernels;
+	std::vector<unsigned> active_chunks;
+	std::vector<std::size_t> worker_chunks;    // Worker `i` updates active_chunks[worker_chunks[i], worker_chunks[i + 1]).
+	std::vector<PopulationStats> stats;
+	std::uint64_t update_counter = 0;
+	bool painting = true;
+
+	// Fraction of a FixedYears unit the steps so far were longer than whole units, in 1/65536 units.
+	std::uint32_t time_fraction = 0;
+
+	// Simulated time in FixedYears units and the pending events, only used with scheduled events.
+	std::uint32_t simulated_time = 0;
+	TimingWheel event_wheel;
+};
+
+// Register the test teams and spawn their starting tribes.
+void create_test_tribes(World& world);
+
+// Return the recorded statistics as a formatted string.
+std::string population_statistics_to_string(const std::vector<PopulationStats>& population_stats, const TeamRegistry& teams);
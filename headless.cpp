@@ -0,0 +1,97 @@
+/*
+*   Copyright (C) 2018 Paul Bernitz
+*
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*	
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <string>
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Clock.hpp>
+
+#include "core/world.hpp"
+#include "core/fixed_step_clock.hpp"
+
+/*---------------------------------------------------------------.
+| Runs the simulation as fast as possible, without window, font  |
+| or texture, and prints the population statistics.              |
+`---------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+	// Parse the command line.
+	std::string terrain_path{ "_texture/world_maps_seapath.png" };
+	unsigned long long total_ticks = 1000;
+	unsigned long long stats_interval = 0, snapshot_interval = 0;
+	bool scheduled_events = false;
+	CpuTier tier = detect_cpu_tier();
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg{ argv[i] };
+		const bool has_value = (i + 1 < argc);
+		if (arg == "--ticks" && has_value)
+			total_ticks = std::stoull(argv[++i]);
+		else if (arg == "--terrain" && has_value)
+			terrain_path = argv[++i];
+		else if (arg == "--stats-every" && has_value)
+			stats_interval = std::stoull(argv[++i]);
+		else if (arg == "--snapshot-every" && has_value)
+			snapshot_interval = std::stoull(argv[++i]);
+		else if (arg == "--events")
+			scheduled_events = true;
+		else if (arg == "--simd" && has_value && parse_cpu_tier(argv[i + 1], tier))
+			++i;
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--terrain <png>] [--ticks <n>] [--stats-every <n>] [--snapshot-every <n>] [--events] [--simd <scalar|sse2|sse4.2|avx2|avx512>]\n";
+			return 1;
+		}
+	}
+
+	// Background map.
+	sf::Image background_map_image;
+	if (!background_map_image.loadFromFile(terrain_path))
+	{
+		std::cerr << "Could not load terrain from " << terrain_path << "\n";
+		return 1;
+	}
+
+	// Create world. The image is not painted while stepping, only repainted for each snapshot.
+	const Config config = with_scheduled_events(default_config(), scheduled_events);
+	World world{ config, background_map_image.getSize().x, background_map_image.getSize().y, background_map_image.getPixelsPtr(),
+		std::thread::hardware_concurrency(), tier };
+	create_test_tribes(world);
+	world.set_painting(false);
+
+	sf::Clock run_clock;
+	for (unsigned long long tick = 1; tick <= total_ticks; ++tick)
+	{
+		const bool print_stats = (tick == total_ticks || (stats_interval > 0 && tick % stats_interval == 0));
+		world.step(SIMULATED_YEARS_PER_STEP, print_stats);
+
+		if (print_stats)
+			std::cout << "Tick " << tick << "\n" << population_statistics_to_string(world.population_stats(), world.teams());
+		if (snapshot_interval > 0 && tick % snapshot_interval == 0)
+		{
+			world.repaint();
+			sf::Image snapshot;
+			snapshot.create(world.width(), world.height(), world.pixels().data());
+			snapshot.saveToFile("snapshot_" + std::to_string(tick) + ".png");
+		}
+	}
+
+	const float elapsed = run_clock.getElapsedTime().asSeconds();
+	std::cout << total_ticks << " ticks in " << elapsed << "s (" << (elapsed > 0.f ? total_ticks / elapsed : 0.f) << " ticks/s, " << cpu_tier_name(world.kernel_tier()) << ")\n";
+	return 0;
+}